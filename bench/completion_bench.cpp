@@ -0,0 +1,144 @@
+// Cost of tracking out-of-order completions: progress::CompletionTracker
+// against a mutex-protected set of the items finished past the watermark.
+//
+//     bench/completion_bench [items] [threads] [window]
+//
+// Threads take items in order and finish them in a random order within
+// windows of |window| items, as a pool of workers would. Then every item is
+// marked by all the threads at once, racing with the pages being freed, and
+// the counts are checked.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "progress_completion.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+namespace {
+
+// what a checkpointing loop without a bitmap would do
+class SetTracker {
+  public:
+    bool Mark(uint64_t index) {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (index < watermark_ || !done_.insert(index).second)
+            return false;
+        while (!done_.empty() && *done_.begin() == watermark_) {
+            done_.erase(done_.begin());
+            ++watermark_;
+        }
+        return true;
+    }
+
+    uint64_t Watermark() {
+        std::lock_guard<std::mutex> lock(mu_);
+        return watermark_;
+    }
+
+  private:
+    std::mutex mu_;
+    std::set<uint64_t> done_;
+    uint64_t watermark_ = 0;
+};
+
+} // namespace
+
+template <typename Mark>
+static double run(const std::vector<uint64_t> &order, unsigned threads, Mark mark) {
+    std::atomic<uint64_t> next(0);
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+        workers.emplace_back([&] {
+            uint64_t i;
+            while ((i = next.fetch_add(1, std::memory_order_relaxed)) < order.size())
+                mark(order[i]);
+        });
+    for (std::thread &worker : workers)
+        worker.join();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+         / order.size();
+}
+
+int main(int argc, char **argv) {
+    uint64_t items = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000000;
+    unsigned threads = argc > 2 ? atoi(argv[2]) : 4;
+    uint64_t window = argc > 3 ? strtoull(argv[3], nullptr, 10) : 100000;
+
+    std::vector<uint64_t> order(items);
+    for (uint64_t i = 0; i < items; ++i)
+        order[i] = i;
+    std::mt19937_64 random(1);
+    for (uint64_t i = 0; i < items; i += window)
+        std::shuffle(order.begin() + i, order.begin() + std::min(items, i + window), random);
+
+    {
+        std::ostringstream sink;
+        ProgressBar bar(items, "items", sink);
+        progress::CompletionTracker tracker(bar);
+        std::atomic<uint64_t> peak(0);
+        double ns = run(order, threads, [&](uint64_t index) {
+            tracker.Mark(index);
+            if (index % 4096 == 0)
+                peak = std::max<uint64_t>(peak, tracker.Pages());
+        });
+        printf("%-28s %8.1f ns/item  watermark %llu, peak %llu pages of %llu items\n",
+               "CompletionTracker", ns, static_cast<unsigned long long>(tracker.Watermark()),
+               static_cast<unsigned long long>(peak.load()),
+               static_cast<unsigned long long>(progress::CompletionTracker::kPageItems));
+    }
+
+    {
+        // each item taken by every thread in a row, so that duplicate marks
+        // run while the watermark passes their page
+        std::vector<uint64_t> duplicates;
+        duplicates.reserve(items * threads);
+        for (uint64_t i = 0; i < items; ++i)
+            duplicates.insert(duplicates.end(), threads, order[i]);
+
+        std::ostringstream sink;
+        ProgressBar bar(items, "items", sink);
+        progress::CompletionTracker tracker(bar);
+        std::atomic<uint64_t> fresh(0);
+        double ns = run(duplicates, threads, [&](uint64_t index) {
+            if (tracker.Mark(index))
+                fresh.fetch_add(1, std::memory_order_relaxed);
+        });
+        if (fresh != items || tracker.Completed() != items || tracker.Watermark() != items
+            || tracker.Pages() != 0 || bar.GetSnapshot().progress != items) {
+            fprintf(stderr, "duplicate marks: %llu fresh, %llu completed, watermark %llu, "
+                    "%llu pages left of %llu items\n",
+                    static_cast<unsigned long long>(fresh.load()),
+                    static_cast<unsigned long long>(tracker.Completed()),
+                    static_cast<unsigned long long>(tracker.Watermark()),
+                    static_cast<unsigned long long>(tracker.Pages()),
+                    static_cast<unsigned long long>(items));
+            return 1;
+        }
+        printf("%-28s %8.1f ns/mark  each item marked once of %u\n",
+               "CompletionTracker, dups", ns, threads);
+    }
+
+    {
+        std::ostringstream sink;
+        ProgressBar bar(items, "items", sink);
+        SetTracker tracker;
+        double ns = run(order, threads, [&](uint64_t index) {
+            if (tracker.Mark(index))
+                ++bar;
+        });
+        printf("%-28s %8.1f ns/item  watermark %llu\n", "mutex and std::set", ns,
+               static_cast<unsigned long long>(tracker.Watermark()));
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// progress::copy_file with every method against cp and a naive
+// read/write loop, on a file of the given size in the given directory.
+// The source stays in the page cache, so this measures the copy path
+// rather than the disks.
+//
+//     bench/copy_bench [size_mb] [directory]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "progress_copy.hpp"
+
+const size_t kNaiveBufferSize = 64 * 1024;
+
+
+static void naive_copy(const std::string &from, const std::string &to) {
+    int in = open(from.c_str(), O_RDONLY);
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    std::vector<char> buffer(kNaiveBufferSize);
+    ssize_t n;
+    while ((n = read(in, &buffer[0], buffer.size())) > 0)
+        if (write(out, &buffer[0], n) != n)
+            break;
+    close(in);
+    close(out);
+}
+
+template <typename Copy>
+static void measure(const char *name, uint64_t size, const std::string &to, Copy copy) {
+    unlink(to.c_str());
+    // writeback of the previous copy must not be charged to this one
+    sync();
+    auto start = std::chrono::steady_clock::now();
+    copy();
+    double seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start).count();
+    printf("%-36s %8.3f s %9.1f MB/s\n", name, seconds, size / seconds / 1e6);
+}
+
+int main(int argc, char **argv) {
+    uint64_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024) << 20;
+    std::string directory = argc > 2 ? argv[2] : "/tmp";
+    std::string from = directory + "/copy_bench.src";
+    std::string to = directory + "/copy_bench.dst";
+
+    {
+        std::mt19937_64 random(42);
+        std::vector<uint64_t> block(1 << 17);
+        int fd = open(from.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        for (uint64_t written = 0; written < size; written += block.size() * 8) {
+            for (uint64_t &word : block)
+                word = random();
+            size_t n = std::min<uint64_t>(size - written, block.size() * 8);
+            if (write(fd, block.data(), n) != static_cast<ssize_t>(n))
+                return 1;
+        }
+        close(fd);
+    }
+    printf("%llu MB in %s\n", static_cast<unsigned long long>(size >> 20), directory.c_str());
+
+    measure("cp", size, to, [&] {
+        if (std::system(("cp " + from + " " + to).c_str()))
+            perror("cp");
+    });
+    measure("read/write loop, 64 KiB", size, to, [&] { naive_copy(from, to); });
+
+    const progress::CopyOptions::Method methods[] = {
+        progress::CopyOptions::kCopyFileRange, progress::CopyOptions::kSendfile,
+        progress::CopyOptions::kSplice, progress::CopyOptions::kReadWrite};
+    for (progress::CopyOptions::Method method : methods) {
+        progress::CopyOptions options;
+        options.method = method;
+        std::string name = std::string("copy_file, ") + progress::copy_method_name(method);
+        measure(name.c_str(), size, to, [&] {
+            std::ostringstream sink;
+            ProgressBar bar(size, "copy", sink);
+            bar.SetByteMode();
+            progress::copy_file(from, to, &bar, options);
+        });
+    }
+
+    progress::CopyOptions options;
+    options.threads = 4;
+    measure("copy_file, auto, 4 threads", size, to, [&] {
+        std::ostringstream sink;
+        ProgressBar bar(size, "copy", sink);
+        bar.SetByteMode();
+        progress::copy_file(from, to, &bar, options);
+    });
+
+    unlink(from.c_str());
+    unlink(to.c_str());
+    return 0;
+}
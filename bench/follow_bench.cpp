@@ -0,0 +1,188 @@
+// CPU time spent following a log file: progress::FileFollower against a
+// loop polling the file size every millisecond, while a writer appends
+// batches of lines.
+//
+//     bench/follow_bench [lines] [batch] [interval_us]
+//
+// The writer appends |lines| lines by batches of |batch| lines every
+// |interval_us| microseconds to /tmp/follow_bench, removed afterwards.
+// Beforehand, a file truncated while followed must be counted again from
+// its start, and a renamed file must end the follow with what it held;
+// the program exits non-zero otherwise.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "progress_follow.hpp"
+#include "progress_lines.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+const char *kPath = "/tmp/follow_bench";
+const char *kRenamedPath = "/tmp/follow_bench.renamed";
+const std::chrono::seconds kTimeout(5);
+
+
+static double thread_cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+         + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void write_lines(int lines, int batch, int interval_us) {
+    int fd = open(kPath, O_WRONLY | O_APPEND);
+    std::string text;
+    for (int i = 0; i < batch; ++i)
+        text += "2026-01-01 00:00:00 INFO ingested record " + std::to_string(i) + "\n";
+    for (int written = 0; written < lines; written += batch) {
+        if (write(fd, text.data(), text.size()) < 0)
+            break;
+        std::this_thread::sleep_for(std::chrono::microseconds(interval_us));
+    }
+    close(fd);
+}
+
+static void append_lines(const char *path, int lines) {
+    int fd = open(path, O_WRONLY | O_APPEND);
+    for (int i = 0; i < lines; ++i) {
+        std::string line = "appended line " + std::to_string(i) + "\n";
+        if (write(fd, line.data(), line.size()) < 0)
+            break;
+    }
+    close(fd);
+}
+
+// false if |done| is still false after kTimeout
+static bool wait_until(const std::function<bool()> &done) {
+    Clock::time_point deadline = Clock::now() + kTimeout;
+    while (!done()) {
+        if (Clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Follows |lines| lines of a file to which |change| is applied, and checks
+// that Run returns |expected| lines in time.
+static bool check_follow(const char *name, int lines, uint64_t total, uint64_t expected,
+                  const std::function<void(const progress::FileFollower &)> &change) {
+    close(open(kPath, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    std::ostringstream sink;
+    ProgressBar bar(total, name, sink);
+    progress::FollowOptions options;
+    options.unit = progress::FollowOptions::kLines;
+    progress::FileFollower follower(kPath, bar, options);
+
+    std::atomic<bool> returned(false);
+    uint64_t counted = 0;
+    std::thread runner([&] {
+        counted = follower.Run();
+        returned = true;
+    });
+    append_lines(kPath, lines);
+    change(follower);
+    bool in_time = wait_until([&] { return returned.load(); });
+    if (!in_time)
+        follower.Stop();
+    runner.join();
+    remove(kPath);
+    remove(kRenamedPath);
+
+    bool ok = in_time && counted == expected && bar.GetSnapshot().progress == expected;
+    printf("%-32s %llu of %llu lines%s\n", name, static_cast<unsigned long long>(counted),
+           static_cast<unsigned long long>(expected), ok ? "" : in_time ? ", FAILED" : ", timed out");
+    return ok;
+}
+
+static void report(const char *name, double wall, double cpu, uint64_t lines) {
+    printf("%-32s %8.3f s wall  %8.4f s cpu (%5.2f%%)  %llu lines\n", name, wall, cpu,
+           100 * cpu / wall, static_cast<unsigned long long>(lines));
+}
+
+int main(int argc, char **argv) {
+    int lines = argc > 1 ? atoi(argv[1]) : 100000;
+    int batch = argc > 2 ? atoi(argv[2]) : 100;
+    int interval_us = argc > 3 ? atoi(argv[3]) : 2000;
+    lines -= lines % batch;
+
+    // once the lines are read, the file is truncated and shorter lines
+    // appended, which must be counted from the start of the file
+    bool truncated = check_follow("truncated and appended", 1000, 1100, 1100,
+                                  [](const progress::FileFollower &follower) {
+        if (wait_until([&] { return follower.Lines() == 1000; }) && !truncate(kPath, 0))
+            append_lines(kPath, 100);
+    });
+    // renamed before all the lines expected were written
+    bool renamed = check_follow("renamed", 1000, 2000, 1000,
+                                [](const progress::FileFollower &) {
+        rename(kPath, kRenamedPath);
+    });
+    if (!truncated || !renamed)
+        return 1;
+
+    {
+        close(open(kPath, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+        std::ostringstream sink;
+        ProgressBar bar(lines, "ingest", sink);
+        progress::FollowOptions options;
+        options.unit = progress::FollowOptions::kLines;
+        progress::FileFollower follower(kPath, bar, options);
+
+        Clock::time_point start = Clock::now();
+        double cpu = thread_cpu_seconds();
+        std::thread writer(write_lines, lines, batch, interval_us);
+        uint64_t counted = follower.Run();
+        cpu = thread_cpu_seconds() - cpu;
+        writer.join();
+        report("FileFollower (inotify)", std::chrono::duration<double>(Clock::now() - start).count(),
+               cpu, counted);
+    }
+
+    {
+        // what a follower without inotify would do
+        close(open(kPath, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+        int fd = open(kPath, O_RDONLY);
+        std::ostringstream sink;
+        ProgressBar bar(lines, "ingest", sink);
+        Clock::time_point start = Clock::now();
+        double cpu = thread_cpu_seconds();
+        std::thread writer(write_lines, lines, batch, interval_us);
+        uint64_t counted = 0, offset = 0;
+        char buffer[64 * 1024];
+        while (counted < static_cast<uint64_t>(lines)) {
+            struct stat st;
+            fstat(fd, &st);
+            while (offset < static_cast<uint64_t>(st.st_size)) {
+                ssize_t n = pread(fd, buffer, sizeof(buffer), offset);
+                if (n <= 0)
+                    break;
+                offset += n;
+                uint64_t newlines = progress::count_newlines(buffer, n);
+                bar += newlines;
+                counted += newlines;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        cpu = thread_cpu_seconds() - cpu;
+        writer.join();
+        close(fd);
+        report("fstat polling every 1 ms", std::chrono::duration<double>(Clock::now() - start).count(),
+               cpu, counted);
+    }
+
+    remove(kPath);
+    return 0;
+}
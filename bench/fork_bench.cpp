@@ -0,0 +1,171 @@
+// Stress of fork() while bars are drawn: threads increment a bar drawing
+// every increment and an observed counter, while the main thread forks
+// repeatedly, and the cost of a fork with the handlers in place.
+//
+//     bench/fork_bench [forks] [threads]
+//
+// Each child must neither deadlock nor draw: it increments and destroys
+// the inherited bars, which must draw no frame, then
+// creates and completes a bar of its own. Once the children are reaped,
+// the bars of the parent are completed and each must have drawn exactly
+// one final frame. A child still running after 10 seconds is killed by an
+// alarm and counts as deadlocked. The bars checked are created after
+// kOtherBars others, past the first chunk of the registry of live bars.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "progress_bar.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// never reached while forking, the bars are completed afterwards
+const uint64_t kTotal = 1ULL << 40;
+const unsigned kDeadlockSeconds = 10;
+const size_t kOtherBars = 100;
+
+
+namespace {
+
+// Counts the frames a bar draws, each ended by a carriage return, and
+// those drawn at the total, without keeping them.
+class FrameCounter : public std::streambuf {
+  public:
+    explicit FrameCounter(uint64_t total)
+          : counts_(", " + std::to_string(total) + "/" + std::to_string(total) + ",") {}
+
+    size_t Frames() const { return frames_; }
+    size_t FinalFrames() const { return final_frames_; }
+
+  protected:
+    int overflow(int c) override {
+        if (c == '\r' || c == '\n') {
+            // the blank lines erasing the previous frame are not frames
+            if (line_.find('[') != std::string::npos)
+                ++frames_;
+            if (line_.find(counts_) != std::string::npos)
+                ++final_frames_;
+            line_.clear();
+        } else if (c != traits_type::eof()) {
+            line_ += static_cast<char>(c);
+        }
+        return c;
+    }
+
+  private:
+    std::string counts_;
+    std::string line_;
+    size_t frames_ = 0;
+    size_t final_frames_ = 0;
+};
+
+} // namespace
+
+// in the child, only the forking thread is left
+static int child_check(std::unique_ptr<ProgressBar> &drawn, const FrameCounter &drawn_frames,
+                std::unique_ptr<ProgressBar> &observed, const FrameCounter &observed_frames) {
+    alarm(kDeadlockSeconds);
+
+    size_t drawn_count = drawn_frames.Frames();
+    size_t observed_count = observed_frames.Frames();
+    *drawn += 1;
+    drawn.reset();
+    observed.reset();
+    if (drawn_frames.Frames() != drawn_count || observed_frames.Frames() != observed_count) {
+        fprintf(stderr, "child %d drew an inherited bar\n", getpid());
+        return 1;
+    }
+
+    FrameCounter frames(100);
+    std::ostream sink(&frames);
+    {
+        ProgressBar bar(100, "child", sink);
+        for (int i = 0; i < 100; ++i)
+            ++bar;
+    }
+    if (frames.FinalFrames() != 1) {
+        fprintf(stderr, "child %d: %zu final frames of its own bar\n", getpid(),
+                frames.FinalFrames());
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int forks = argc > 1 ? atoi(argv[1]) : 200;
+    unsigned threads = argc > 2 ? atoi(argv[2]) : 4;
+    alarm(kDeadlockSeconds * 6);
+
+    FrameCounter other_frames(kTotal);
+    std::ostream other_sink(&other_frames);
+    std::vector<std::unique_ptr<ProgressBar>> others;
+    for (size_t i = 0; i < kOtherBars; ++i)
+        others.emplace_back(new ProgressBar(kTotal, "other", other_sink));
+
+    FrameCounter drawn_frames(kTotal), observed_frames(kTotal);
+    std::ostream drawn_sink(&drawn_frames), observed_sink(&observed_frames);
+    std::unique_ptr<ProgressBar> drawn(new ProgressBar(kTotal, "drawn", drawn_sink));
+    drawn->SetFrequencyUpdate(1);
+    std::atomic<uint64_t> counter(0);
+    std::unique_ptr<ProgressBar> observed(
+        new ProgressBar(kTotal, counter, "observed", observed_sink));
+
+    std::atomic<bool> forking(true);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+        workers.emplace_back([&] {
+            while (forking) {
+                *drawn += 1;
+                counter.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+
+    int failures = 0;
+    double fork_us = 0;
+    for (int i = 0; i < forks; ++i) {
+        Clock::time_point start = Clock::now();
+        pid_t pid = fork();
+        if (pid == 0)
+            _exit(child_check(drawn, drawn_frames, observed, observed_frames));
+        fork_us += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+
+        int status;
+        waitpid(pid, &status, 0);
+        if (WIFSIGNALED(status)) {
+            fprintf(stderr, "child %d killed by signal %d%s\n", pid, WTERMSIG(status),
+                    WTERMSIG(status) == SIGALRM ? ", deadlocked" : "");
+            ++failures;
+        } else if (WEXITSTATUS(status)) {
+            ++failures;
+        }
+    }
+    forking = false;
+    for (std::thread &worker : workers)
+        worker.join();
+
+    uint64_t done = drawn->GetSnapshot().progress;
+    *drawn += kTotal - done;
+    counter = kTotal;
+    drawn.reset();
+    observed.reset();
+
+    printf("%d forks with %u threads drawing: %.1f us/fork, %zu frames drawn meanwhile, "
+           "%d failed children, final frames %zu and %zu\n",
+           forks, threads, fork_us / std::max(forks, 1), drawn_frames.Frames(), failures,
+           drawn_frames.FinalFrames(), observed_frames.FinalFrames());
+    return failures || drawn_frames.FinalFrames() != 1 || observed_frames.FinalFrames() != 1;
+}
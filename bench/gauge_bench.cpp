@@ -0,0 +1,71 @@
+// Cost of updating a live value shown in the bar from several threads:
+// a gauge, against SetLabel with the value formatted by each update.
+//
+//     bench/gauge_bench [updates] [threads]
+//
+// Every thread updates an in-flight count twice per item, and increments
+// the bar once.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "progress_bar.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+static double run(uint64_t items, unsigned threads, const std::function<void(uint64_t)> &item) {
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+        workers.emplace_back([&, t] {
+            for (uint64_t i = t; i < items; i += threads)
+                item(i);
+        });
+    for (std::thread &worker : workers)
+        worker.join();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / items;
+}
+
+int main(int argc, char **argv) {
+    uint64_t items = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    unsigned threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    {
+        std::ostringstream sink;
+        ProgressBar bar(items, "requests", sink);
+        double ns = run(items, threads, [&](uint64_t) { ++bar; });
+        printf("%-28s %8.1f ns/item\n", "++bar alone", ns);
+    }
+
+    {
+        std::ostringstream sink;
+        ProgressBar bar(items, "requests", sink);
+        ProgressBar::Gauge in_flight = bar.AddGauge("in flight");
+        double ns = run(items, threads, [&](uint64_t) {
+            in_flight.Add(1);
+            ++bar;
+            in_flight.Add(-1);
+        });
+        printf("%-28s %8.1f ns/item\n", "gauge", ns);
+    }
+
+    {
+        std::ostringstream sink;
+        ProgressBar bar(items, "requests", sink);
+        std::atomic<int64_t> in_flight(0);
+        double ns = run(items, threads, [&](uint64_t) {
+            bar.SetLabel("in flight " + std::to_string(++in_flight));
+            ++bar;
+            bar.SetLabel("in flight " + std::to_string(--in_flight));
+        });
+        printf("%-28s %8.1f ns/item\n", "SetLabel", ns);
+    }
+    return 0;
+}
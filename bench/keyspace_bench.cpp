@@ -0,0 +1,120 @@
+// Cost and accuracy of key-space progress over a scan of sorted keys:
+// ++bar per key against KeySpace cursors storing the latest key, with
+// the error of the interpolated progress against the true fraction of
+// keys scanned.
+//
+//     bench/keyspace_bench [keys] [threads]
+//
+// The keys are random 16-byte strings behind a common 8-byte prefix,
+// sorted and stored back to back as in a sorted file, and split in
+// |threads| contiguous ranges scanned in parallel. Each variant is run 3
+// times and the best is kept.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "progress_keyspace.hpp"
+#include "progress_bar.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+const size_t kKeySize = 24;
+
+
+// the scan itself, a checksum of the key
+inline uint64_t scan(const char *key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < kKeySize; ++i)
+        hash = (hash ^ static_cast<unsigned char>(key[i])) * 1099511628211ULL;
+    return hash;
+}
+
+template <typename Scan>
+static double run(size_t keys, unsigned threads, Scan scan_range) {
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+        workers.emplace_back(scan_range, keys * t / threads, keys * (t + 1) / threads);
+    for (std::thread &worker : workers)
+        worker.join();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / keys;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+    unsigned threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    std::mt19937_64 random(1);
+    std::vector<std::string> keys(n);
+    for (std::string &key : keys) {
+        key = "user:00:";
+        for (int i = 0; i < 16; ++i)
+            key += static_cast<char>(random() & 0xff);
+    }
+    std::sort(keys.begin(), keys.end());
+    std::string records;
+    for (const std::string &key : keys)
+        records += key;
+    auto key = [&records](size_t i) { return records.data() + i * kKeySize; };
+    std::string first = "user:00:", last = "user:00;";
+
+    std::atomic<uint64_t> sink_hash(0);
+    double baseline = 1e9, with_bar = 1e9, with_cursors = 1e9;
+    for (int pass = 0; pass < 3; ++pass) {
+        baseline = std::min(baseline, run(n, threads, [&](size_t begin, size_t end) {
+            uint64_t hash = 0;
+            for (size_t i = begin; i < end; ++i)
+                hash += scan(key(i));
+            sink_hash += hash;
+        }));
+
+        std::ostringstream sink;
+        ProgressBar bar(n, "scan", sink);
+        with_bar = std::min(with_bar, run(n, threads, [&](size_t begin, size_t end) {
+            uint64_t hash = 0;
+            for (size_t i = begin; i < end; ++i) {
+                hash += scan(key(i));
+                ++bar;
+            }
+            sink_hash += hash;
+        }));
+
+        progress::KeySpace space(first, last);
+        std::ostringstream space_sink;
+        ProgressBar space_bar(progress::KeySpace::kUnits, [&space] { return space.Progress(); },
+                              "scan", space_sink);
+        with_cursors = std::min(with_cursors, run(n, threads, [&](size_t begin, size_t end) {
+            // the bounds of a range are known before its keys
+            progress::KeySpace::Cursor cursor = space.AddRange(
+                begin ? keys[begin] : first, end < n ? keys[end] : last);
+            uint64_t hash = 0;
+            for (size_t i = begin; i < end; ++i) {
+                hash += scan(key(i));
+                cursor.Set(key(i), kKeySize);
+            }
+            cursor.Finish();
+            sink_hash += hash;
+        }));
+        if (space.Progress() != progress::KeySpace::kUnits)
+            printf("incomplete key-space progress\n");
+    }
+    printf("%-28s %8.2f ns/key\n", "no bar", baseline);
+    printf("%-28s %8.2f ns/key\n", "++bar", with_bar);
+    printf("%-28s %8.2f ns/key\n", "KeySpace cursors", with_cursors);
+
+    progress::KeySpace space(first, last);
+    double worst = 0;
+    for (size_t i = 0; i < n; i += std::max<size_t>(1, n / 1000))
+        worst = std::max(worst, std::fabs(space.Fraction(keys[i]) - static_cast<double>(i) / n));
+    printf("%-28s %8.4f%% of the key space\n", "worst interpolation error", worst * 100);
+    return sink_hash == 42;
+}
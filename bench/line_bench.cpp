@@ -0,0 +1,118 @@
+// Counting the lines of a file: the newline kernels and threads of
+// progress::count_lines against `wc -l`, then a std::getline loop alone,
+// with a line-counting pass before it, and with progress::LineProgress.
+//
+//     bench/line_bench [size_mb] [file]
+//
+// Without a file, one of |size_mb| MB (default 512) of lines of random
+// length is written to /tmp/line_bench and removed afterwards. The file
+// is read once beforehand, so all runs are from the page cache.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "progress_lines.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+static double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void create_file(const std::string &path, size_t size) {
+    std::mt19937 random(42);
+    std::string line;
+    std::ofstream out(path, std::ios::binary);
+    for (size_t written = 0; written < size; written += line.size()) {
+        line.assign(random() % 160, 'x');
+        line += '\n';
+        out << line;
+    }
+}
+
+static void report(const std::string &name, double seconds, uint64_t lines, size_t size) {
+    printf("%-36s %8.3f s  %8.0f MB/s  %llu lines\n", name.c_str(), seconds,
+           size / seconds / 1e6, static_cast<unsigned long long>(lines));
+}
+
+// checksum of the lines so that the loop is not optimized away
+static uint64_t getline_loop(const std::string &path, progress::LineProgress *progress) {
+    std::ifstream in(path);
+    std::string line;
+    uint64_t checksum = 0;
+    while (std::getline(in, line)) {
+        checksum += line.size();
+        if (progress)
+            progress->Line(line.size() + 1);
+    }
+    return checksum;
+}
+
+int main(int argc, char **argv) {
+    size_t size_mb = argc > 1 ? atoi(argv[1]) : 512;
+    std::string path = argc > 2 ? argv[2] : "/tmp/line_bench";
+    bool created = argc < 3;
+    if (created)
+        create_file(path, size_mb << 20);
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    size_t size = in.tellg();
+    progress::count_lines(path);
+
+    Clock::time_point start = Clock::now();
+    FILE *wc = popen(("wc -l < " + path).c_str(), "r");
+    unsigned long long wc_lines = 0;
+    if (!wc || fscanf(wc, "%llu", &wc_lines) != 1 || pclose(wc))
+        return 1;
+    report("wc -l", seconds_since(start), wc_lines, size);
+
+    // the kernels alone, over the file in memory
+    std::ifstream file(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    for (int kernel = progress::kScalarKernel; kernel <= progress::best_newline_kernel(); ++kernel) {
+        start = Clock::now();
+        uint64_t newlines = progress::count_newlines(data.data(), data.size(),
+                                                     progress::NewlineKernel(kernel));
+        report(std::string("count_newlines, ")
+                   + progress::newline_kernel_name(progress::NewlineKernel(kernel)),
+               seconds_since(start), newlines, size);
+    }
+    std::string().swap(data);
+
+    for (unsigned threads : {1u, 4u}) {
+        start = Clock::now();
+        uint64_t lines = progress::count_lines(path, nullptr, threads);
+        report("count_lines, " + std::to_string(threads) + " threads",
+               seconds_since(start), lines, size);
+    }
+
+    start = Clock::now();
+    uint64_t checksum = getline_loop(path, nullptr);
+    report("getline loop", seconds_since(start), 0, size);
+
+    start = Clock::now();
+    uint64_t lines = progress::count_lines(path);
+    getline_loop(path, nullptr);
+    report("count_lines, then getline loop", seconds_since(start), lines, size);
+
+    std::ostringstream sink;
+    start = Clock::now();
+    {
+        ProgressBar bar(size, "lines", sink);
+        progress::LineProgress progress(bar, path);
+        if (getline_loop(path, &progress) != checksum)
+            return 1;
+    }
+    report("getline loop with LineProgress", seconds_since(start), 0, size);
+
+    if (created)
+        remove(path.c_str());
+    return 0;
+}
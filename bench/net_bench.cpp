@@ -0,0 +1,162 @@
+// Aggregation of progress over loopback: a tree of forked processes where
+// leaf nodes publish to mid-level aggregators, which forward to the root.
+//
+//     bench/net_bench [mids] [leaves] [items]
+//
+// Every leaf counts a different number of items, about |items| times its
+// rank, publishing the second half through a new connection as after a
+// reconnection, and exits. Each aggregator waits
+// for its children, then for its bar to reach the sum of their totals, and
+// checks the progress and total of its bar and of every node it saw. The
+// root reports the time from the start to the aggregated completion and
+// exits non-zero on any mismatch or timeout.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "progress_net.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+const char *kHost = "127.0.0.1";
+const std::chrono::milliseconds kInterval(10);
+const std::chrono::seconds kTimeout(20);
+
+
+static uint64_t leaf_total(int mid, int leaf, uint64_t items) {
+    return items * (leaf + 1) + mid;
+}
+
+// waits for |bar| to reach |total|, false on timeout
+static bool wait_for(const ProgressBar &bar, uint64_t total) {
+    Clock::time_point deadline = Clock::now() + kTimeout;
+    while (bar.GetSnapshot().progress != total || bar.GetSnapshot().total != total) {
+        if (Clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// false if a child failed or did not exit
+static bool wait_children(const std::vector<pid_t> &children) {
+    bool ok = true;
+    for (pid_t pid : children) {
+        int status;
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+            ok = false;
+    }
+    return ok;
+}
+
+// the aggregated progress of every node, named |prefix| and their index
+static bool check_nodes(const ProgressAggregator &aggregator, const std::string &prefix,
+                 const std::vector<uint64_t> &totals) {
+    std::vector<ProgressAggregator::NodeStatus> nodes = aggregator.Nodes();
+    bool ok = nodes.size() == totals.size();
+    for (const ProgressAggregator::NodeStatus &node : nodes) {
+        size_t i = strtoul(node.name.c_str() + prefix.size(), nullptr, 10);
+        if (node.name.compare(0, prefix.size(), prefix) || i >= totals.size()
+                || node.progress != totals[i] || node.total != totals[i]) {
+            fprintf(stderr, "%d: node %s at %llu/%llu\n", getpid(), node.name.c_str(),
+                    static_cast<unsigned long long>(node.progress),
+                    static_cast<unsigned long long>(node.total));
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// in a forked child, which exits without destroying the inherited objects
+static int run_leaf(uint16_t port, int mid, int leaf, uint64_t items) {
+    uint64_t total = leaf_total(mid, leaf, items);
+    std::ostringstream sink;
+    ProgressBar bar(total, "leaf", sink);
+    for (int half = 0; half < 2; ++half) {
+        // the second publisher sends the progress of the first one again
+        ProgressPublisher publisher(bar, kHost, port, "leaf-" + std::to_string(leaf), kInterval);
+        // a few intervals of work, so that several updates are coalesced
+        for (uint64_t i = half ? total / 2 : 0; i < (half ? total : total / 2); ++i) {
+            ++bar;
+            if (i % (total / 20 + 1) == 0)
+                std::this_thread::sleep_for(kInterval / 2);
+        }
+    }
+    return 0;
+}
+
+static int run_mid(uint16_t root_port, int mid, int leaves, uint64_t items) {
+    std::ostringstream sink;
+    ProgressBar bar(0, "mid", sink);
+    ProgressAggregator aggregator(bar);
+
+    std::vector<uint64_t> totals;
+    std::vector<pid_t> children;
+    for (int leaf = 0; leaf < leaves; ++leaf) {
+        totals.push_back(leaf_total(mid, leaf, items));
+        pid_t pid = fork();
+        if (pid == 0)
+            _exit(run_leaf(aggregator.Port(), mid, leaf, items));
+        children.push_back(pid);
+    }
+
+    uint64_t sum = 0;
+    for (uint64_t total : totals)
+        sum += total;
+    ProgressPublisher publisher(bar, kHost, root_port, "mid-" + std::to_string(mid), kInterval);
+    bool ok = wait_children(children) && wait_for(bar, sum)
+              && check_nodes(aggregator, "leaf-", totals);
+    if (!ok)
+        fprintf(stderr, "mid-%d: %llu/%llu of %llu\n", mid,
+                static_cast<unsigned long long>(bar.GetSnapshot().progress),
+                static_cast<unsigned long long>(bar.GetSnapshot().total),
+                static_cast<unsigned long long>(sum));
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    int mids = argc > 1 ? atoi(argv[1]) : 3;
+    int leaves = argc > 2 ? atoi(argv[2]) : 4;
+    uint64_t items = argc > 3 ? strtoull(argv[3], nullptr, 10) : 100000;
+
+    Clock::time_point start = Clock::now();
+    std::ostringstream sink;
+    ProgressBar bar(0, "root", sink);
+    ProgressAggregator aggregator(bar);
+
+    std::vector<uint64_t> totals;
+    std::vector<pid_t> children;
+    uint64_t sum = 0;
+    for (int mid = 0; mid < mids; ++mid) {
+        uint64_t total = 0;
+        for (int leaf = 0; leaf < leaves; ++leaf)
+            total += leaf_total(mid, leaf, items);
+        totals.push_back(total);
+        sum += total;
+        pid_t pid = fork();
+        if (pid == 0)
+            _exit(run_mid(aggregator.Port(), mid, leaves, items));
+        children.push_back(pid);
+    }
+
+    bool children_ok = wait_children(children);
+    bool completed = wait_for(bar, sum);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    bool nodes_ok = check_nodes(aggregator, "mid-", totals);
+
+    ProgressBar::Snapshot snapshot = bar.GetSnapshot();
+    printf("%d aggregators of %d leaves: %llu/%llu of %llu items in %.3f s, %s\n", mids, leaves,
+           static_cast<unsigned long long>(snapshot.progress),
+           static_cast<unsigned long long>(snapshot.total),
+           static_cast<unsigned long long>(sum), seconds,
+           children_ok && completed && nodes_ok ? "ok" : "FAILED");
+    return children_ok && completed && nodes_ok ? 0 : 1;
+}
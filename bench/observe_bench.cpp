@@ -0,0 +1,127 @@
+// Cost of progress reporting inside a tight loop: no bar, ++bar on every
+// iteration, and observe mode over the loop's own atomic counter, plain
+// index and callable.
+//
+//     bench/observe_bench [iterations]
+//
+// The loop body is a few arithmetic operations, so the reporting cost
+// dominates. Bars draw to a string stream; each variant is run 3 times
+// and the best is kept. The frames drawn show whether the bar moved
+// during the loop: the compiler keeps a plain index in a register when
+// the loop makes no call, and the renderer only sees its final value.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+
+#include "progress_bar.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// by the last run of a variant
+static size_t frames_drawn = 0;
+
+
+// best of 3 runs, in nanoseconds per iteration
+static double time_loop(uint64_t n, const std::function<uint64_t()> &loop) {
+    double best = 1e9;
+    for (int run = 0; run < 3; ++run) {
+        Clock::time_point start = Clock::now();
+        uint64_t result = loop();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+        if (result == 42)
+            printf(" ");
+        best = std::min(best, ns);
+    }
+    return best;
+}
+
+static size_t count_frames(const std::ostringstream &sink) {
+    std::string text = sink.str();
+    return std::count(text.begin(), text.end(), '\r') / 2;
+}
+
+inline uint64_t work(uint64_t i, uint64_t x) {
+    return x * 6364136223846793005ULL + (i ^ (x >> 29));
+}
+
+static void report(const char *name, double ns, double baseline, size_t frames) {
+    printf("%-36s %8.3f ns/iteration  %+7.1f%%  %5zu frames\n", name, ns,
+           100 * (ns / baseline - 1), frames);
+}
+
+int main(int argc, char **argv) {
+    uint64_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000000;
+
+    double baseline = time_loop(n, [n] {
+        uint64_t x = 1;
+        for (uint64_t i = 0; i < n; ++i)
+            x = work(i, x);
+        return x;
+    });
+    report("no bar", baseline, baseline, 0);
+
+    double ns = time_loop(n, [n] {
+        std::ostringstream sink;
+        ProgressBar bar(n, "loop", sink);
+        uint64_t x = 1;
+        for (uint64_t i = 0; i < n; ++i) {
+            x = work(i, x);
+            ++bar;
+        }
+        frames_drawn = count_frames(sink);
+        return x;
+    });
+    report("++bar", ns, baseline, frames_drawn);
+
+    ns = time_loop(n, [n] {
+        std::ostringstream sink;
+        std::atomic<uint64_t> done(0);
+        ProgressBar bar(n, done, "loop", sink);
+        uint64_t x = 1;
+        for (uint64_t i = 0; i < n; ++i) {
+            x = work(i, x);
+            done.store(i + 1, std::memory_order_relaxed);
+        }
+        frames_drawn = count_frames(sink);
+        return x;
+    });
+    report("observed std::atomic counter", ns, baseline, frames_drawn);
+
+    ns = time_loop(n, [n] {
+        std::ostringstream sink;
+        uint64_t i = 0;
+        ProgressBar bar(n, i, "loop", sink);
+        uint64_t x = 1;
+        for (; i < n; ++i)
+            x = work(i, x);
+        frames_drawn = count_frames(sink);
+        return x;
+    });
+    report("observed plain index", ns, baseline, frames_drawn);
+
+    // the loop publishes a count of batches, the callable scales it
+    ns = time_loop(n, [n] {
+        std::ostringstream sink;
+        std::atomic<uint64_t> batches(0);
+        ProgressBar bar(n, [&batches, n] {
+            return std::min(n, batches.load(std::memory_order_relaxed) * 64);
+        }, "loop", sink);
+        uint64_t x = 1;
+        for (uint64_t i = 0; i < n; ++i) {
+            x = work(i, x);
+            if (i % 64 == 63)
+                batches.store((i + 1) / 64, std::memory_order_relaxed);
+        }
+        batches.store((n + 63) / 64);
+        frames_drawn = count_frames(sink);
+        return x;
+    });
+    report("observed callable, batches of 64", ns, baseline, frames_drawn);
+    return 0;
+}
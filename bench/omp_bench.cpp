@@ -0,0 +1,98 @@
+// Cost of progress reporting inside OpenMP loops, for static and dynamic
+// schedules: no reporting, a shared ++bar per iteration, OmpProgress::Tick
+// and a Counter per thread.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "progress_bar.hpp"
+#include "progress_omp.hpp"
+
+const int kIterations = 20000000;
+
+// a few nanoseconds of work that the compiler cannot drop
+inline double work(int i) {
+    return std::sqrt(static_cast<double>(i)) * 1e-9;
+}
+
+template <typename Loop>
+static void measure(const std::string &name, Loop loop) {
+    auto start = std::chrono::steady_clock::now();
+    double sum = loop();
+    double seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start).count();
+    printf("%-32s %8.3f s  %6.2f ns/iter  (%g)\n",
+           name.c_str(), seconds, seconds * 1e9 / kIterations, sum);
+}
+
+// the loops use schedule(runtime), set by omp_set_schedule()
+static void run(omp_sched_t schedule, const std::string &kind) {
+    omp_set_schedule(schedule, 0);
+
+    measure(kind + " / no progress", [] {
+        double sum = 0;
+        #pragma omp parallel for schedule(runtime) reduction(+:sum)
+        for (int i = 0; i < kIterations; ++i)
+            sum += work(i);
+        return sum;
+    });
+
+    measure(kind + " / shared ++bar", [] {
+        std::ostringstream sink;
+        ProgressBar bar(kIterations, "shared", sink);
+        double sum = 0;
+        #pragma omp parallel for schedule(runtime) reduction(+:sum)
+        for (int i = 0; i < kIterations; ++i) {
+            sum += work(i);
+            ++bar;
+        }
+        return sum;
+    });
+
+    measure(kind + " / OmpProgress", [] {
+        std::ostringstream sink;
+        ProgressBar bar(kIterations, "per-thread", sink);
+        double sum = 0;
+        {
+            OmpProgress progress(bar);
+            #pragma omp parallel for schedule(runtime) reduction(+:sum)
+            for (int i = 0; i < kIterations; ++i) {
+                sum += work(i);
+                progress.Tick();
+            }
+        }
+        return sum;
+    });
+
+    measure(kind + " / OmpProgress::Counter", [] {
+        std::ostringstream sink;
+        ProgressBar bar(kIterations, "per-thread", sink);
+        double sum = 0;
+        {
+            OmpProgress progress(bar);
+            #pragma omp parallel reduction(+:sum)
+            {
+                OmpProgress::Counter counter = progress.ThreadCounter();
+                #pragma omp for schedule(runtime)
+                for (int i = 0; i < kIterations; ++i) {
+                    sum += work(i);
+                    counter.Tick();
+                }
+            }
+        }
+        if (bar.GetSnapshot().progress != static_cast<uint64_t>(kIterations))
+            printf("counted %llu of %d\n",
+                   static_cast<unsigned long long>(bar.GetSnapshot().progress), kIterations);
+        return sum;
+    });
+}
+
+int main() {
+    printf("%d threads, %d iterations\n", omp_get_max_threads(), kIterations);
+    run(omp_sched_static, "static");
+    run(omp_sched_dynamic, "dynamic");
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Cost of a ProcessMonitor poll against a process with many open files,
+// and of a naive poll opening fdinfo and stat-ing the file every time.
+//
+//     bench/proc_bench [files]
+//
+// A child opens |files| sparse files of 1 MiB in /tmp/proc_bench and
+// waits; the files are removed afterwards. Beforehand, a child reading a
+// file chunk by chunk in lockstep with the monitor checks the positions
+// it reports, and exits non-zero if one differs.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "progress_proc.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+const char *kDirectory = "/tmp/proc_bench";
+const int kPolls = 200;
+const int kReadChunks = 8;
+const size_t kChunkSize = 512 * 1024;
+
+
+static std::string file_name(int i) {
+    return std::string(kDirectory) + "/" + std::to_string(i);
+}
+
+// what a monitor without kept descriptors nor fixed buffers would do
+static void naive_poll(pid_t pid, int files, int first_fd) {
+    for (int fd = first_fd; fd < first_fd + files; ++fd) {
+        std::string base = "/proc/" + std::to_string(pid);
+        FILE *info = fopen((base + "/fdinfo/" + std::to_string(fd)).c_str(), "r");
+        unsigned long long position = 0;
+        if (info) {
+            if (fscanf(info, "pos: %llu", &position) != 1)
+                position = 0;
+            fclose(info);
+        }
+        struct stat st;
+        stat((base + "/fd/" + std::to_string(fd)).c_str(), &st);
+    }
+}
+
+// the child reads a chunk, or opens or closes the file, every time it is
+// told to, and acknowledges it once done
+static void read_in_steps(const std::string &path, int go_fd, int done_fd) {
+    std::vector<char> chunk(kChunkSize);
+    char step;
+    int fd = -1;
+    for (int i = -1; i <= kReadChunks && read(go_fd, &step, 1) == 1; ++i) {
+        if (i < 0)
+            fd = open(path.c_str(), O_RDONLY);
+        else if (i == kReadChunks)
+            close(fd);
+        else if (read(fd, chunk.data(), kChunkSize) != static_cast<ssize_t>(kChunkSize))
+            _exit(1);
+        if (write(done_fd, &step, 1) != 1)
+            _exit(1);
+    }
+    _exit(0);
+}
+
+// polls the reader after every step, false if the position, the size or
+// the files tracked differ from what it did
+static bool check_reader() {
+    std::string path = std::string(kDirectory) + "/read";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, kReadChunks * kChunkSize))
+        return false;
+    close(fd);
+
+    int go[2], done[2];
+    if (pipe(go) || pipe(done))
+        return false;
+    pid_t child = fork();
+    if (child == 0)
+        read_in_steps(path, go[0], done[1]);
+
+    std::ostringstream sink;
+    progress::MonitorOptions options;
+    options.rescan = 1;
+    progress::ProcessMonitor monitor(child, sink, options);
+    bool ok = true;
+    char step = 0;
+    for (int i = -1; i <= kReadChunks && ok; ++i) {
+        if (write(go[1], &step, 1) != 1 || read(done[0], &step, 1) != 1) {
+            ok = false;
+            break;
+        }
+        monitor.Poll();
+        std::vector<progress::ProcessMonitor::FileStatus> files = monitor.Files();
+        if (i == kReadChunks) {
+            ok = files.empty();
+            if (!ok)
+                fprintf(stderr, "%s still tracked once closed\n", path.c_str());
+            continue;
+        }
+        uint64_t expected = (i + 1) * kChunkSize;
+        ok = files.size() == 1 && files[0].path == path && files[0].position == expected
+             && files[0].size == kReadChunks * kChunkSize;
+        if (!ok)
+            fprintf(stderr, "after %d chunks: %zu files tracked, %s at %llu, expected %llu\n",
+                    i + 1, files.size(), files.empty() ? "none" : files[0].path.c_str(),
+                    static_cast<unsigned long long>(files.empty() ? 0 : files[0].position),
+                    static_cast<unsigned long long>(expected));
+    }
+
+    // the child exits once told to go on after closing the file
+    if (write(go[1], &step, 1) != 1)
+        kill(child, SIGTERM);
+    int status;
+    waitpid(child, &status, 0);
+    if (ok && monitor.Poll()) {
+        fprintf(stderr, "the reader exited but is still polled\n");
+        ok = false;
+    }
+    ok = ok && WIFEXITED(status) && !WEXITSTATUS(status);
+    close(go[0]);
+    close(go[1]);
+    close(done[0]);
+    close(done[1]);
+    unlink(path.c_str());
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int files = argc > 1 ? atoi(argv[1]) : 1000;
+    mkdir(kDirectory, 0755);
+
+    if (!check_reader()) {
+        rmdir(kDirectory);
+        return 1;
+    }
+    printf("positions of a reader in %d chunks of %zu KiB: ok\n", kReadChunks,
+           kChunkSize / 1024);
+
+    int ready[2];
+    if (pipe(ready))
+        return 1;
+    pid_t child = fork();
+    if (child == 0) {
+        int first_fd = -1;
+        for (int i = 0; i < files; ++i) {
+            int fd = open(file_name(i).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0 || ftruncate(fd, 1 << 20))
+                _exit(1);
+            lseek(fd, i, SEEK_SET);
+            if (first_fd < 0)
+                first_fd = fd;
+        }
+        if (write(ready[1], &first_fd, sizeof(first_fd)) != sizeof(first_fd))
+            _exit(1);
+        pause();
+        _exit(0);
+    }
+    int first_fd;
+    if (read(ready[0], &first_fd, sizeof(first_fd)) != sizeof(first_fd))
+        return 1;
+
+    std::ostringstream sink;
+    progress::MonitorOptions options;
+    progress::ProcessMonitor monitor(child, sink, options);
+    monitor.Poll();
+
+    Clock::time_point start = Clock::now();
+    for (int poll = 0; poll < kPolls; ++poll)
+        monitor.Poll();
+    double monitor_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (int poll = 0; poll < kPolls; ++poll)
+        naive_poll(child, files, first_fd);
+    double naive_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    printf("%d files, %zu tracked\n", files, monitor.Files().size());
+    printf("%-36s %10.1f us/poll\n", "ProcessMonitor (rescan every 5)", monitor_us / kPolls);
+    printf("%-36s %10.1f us/poll\n", "open fdinfo and stat every poll", naive_us / kPolls);
+
+    kill(child, SIGTERM);
+    waitpid(child, nullptr, 0);
+    for (int i = 0; i < files; ++i)
+        unlink(file_name(i).c_str());
+    rmdir(kDirectory);
+    return 0;
+}
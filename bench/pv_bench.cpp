@@ -0,0 +1,65 @@
+// Throughput of tools/progress_pv in a pipeline against cat, from a pipe
+// and from a file, with splice and with read/write.
+//
+//     bench/pv_bench [size_mb]
+//
+// The bar goes to stderr, redirected to a file so that the terminal is not
+// part of the measure. Each pipeline is run 3 times and the best is kept.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+typedef std::chrono::steady_clock Clock;
+
+const char *kInput = "/tmp/pv_bench";
+
+
+// best of 3 runs, in seconds
+static double time_pipeline(const std::string &command) {
+    double best = 1e9;
+    for (int run = 0; run < 3; ++run) {
+        Clock::time_point start = Clock::now();
+        if (system(command.c_str()))
+            return -1;
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    size_t size_mb = argc > 1 ? atoi(argv[1]) : 2048;
+    std::string size = std::to_string(size_mb) + "M";
+
+    std::string create = "head -c " + size + " /dev/zero > " + kInput;
+    if (system(create.c_str()))
+        return 1;
+
+    const char *filters[] = {"cat", "tools/progress_pv -m splice 2>/tmp/pv_bench.log",
+                             "tools/progress_pv -m read/write 2>/tmp/pv_bench.log"};
+    const char *names[] = {"cat", "progress_pv, splice", "progress_pv, read/write"};
+
+    printf("%-28s %12s %12s\n", "", "from a pipe", "from a file");
+    double baseline[2] = {0, 0};
+    for (int f = 0; f < 3; ++f) {
+        std::string from_pipe = "head -c " + size + " /dev/zero | " + filters[f]
+                              + " | cat > /dev/null";
+        std::string from_file = std::string(filters[f]) + " < " + kInput + " | cat > /dev/null";
+        double seconds[2] = {time_pipeline(from_pipe), time_pipeline(from_file)};
+
+        printf("%-28s", names[f]);
+        for (int i = 0; i < 2; ++i) {
+            if (!f)
+                baseline[i] = seconds[i];
+            printf("  %5.0f MB/s %+4.0f%%", size_mb * 1.048576 / seconds[i],
+                   100 * (seconds[i] / baseline[i] - 1));
+        }
+        printf("\n");
+    }
+
+    remove(kInput);
+    remove("/tmp/pv_bench.log");
+    return 0;
+}
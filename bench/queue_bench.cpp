@@ -0,0 +1,84 @@
+// Cost of reporting a growing queue: queue-drain mode, where producers
+// call Arrive and consumers increment, against a plain bar whose total is
+// raised with SetTotal on every arrival.
+//
+//     bench/queue_bench [items] [threads]
+//
+// |threads| producers and as many consumers report |items| arrivals and
+// completions in total, without a queue between them: only the reporting
+// is timed. Consumers never complete more items than were reported.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "progress_bar.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+template <typename Arrive, typename Complete>
+static double run(uint64_t items, unsigned threads, Arrive arrive, Complete complete) {
+    // claimed by producers, reported to the bar, and completed
+    std::atomic<uint64_t> claimed(0), arrived(0), completed(0);
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            while (claimed.fetch_add(1) < items) {
+                arrive();
+                arrived.fetch_add(1);
+            }
+        });
+        workers.emplace_back([&] {
+            for (;;) {
+                uint64_t done = completed.load();
+                if (done >= items)
+                    return;
+                if (done >= arrived.load()) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (completed.compare_exchange_weak(done, done + 1))
+                    complete();
+            }
+        });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / items;
+}
+
+int main(int argc, char **argv) {
+    uint64_t items = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    unsigned threads = argc > 2 ? atoi(argv[2]) : 2;
+
+    {
+        std::ostringstream sink;
+        ProgressBar bar(ProgressBar::kQueue, "jobs", sink);
+        double ns = run(items, threads, [&] { bar.Arrive(); }, [&] { ++bar; });
+        printf("%-32s %8.1f ns/item\n", "queue-drain mode", ns);
+    }
+
+    {
+        // raising the total takes a lock, it must not go below the progress
+        std::ostringstream sink;
+        ProgressBar bar(0, "jobs", sink);
+        std::mutex mu;
+        uint64_t total = 0;
+        double ns = run(items, threads, [&] {
+            std::lock_guard<std::mutex> lock(mu);
+            bar.SetTotal(++total);
+        }, [&] {
+            ++bar;
+        });
+        printf("%-32s %8.1f ns/item\n", "SetTotal on every arrival", ns);
+    }
+    return 0;
+}
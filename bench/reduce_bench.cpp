@@ -0,0 +1,73 @@
+// progress::transform_reduce and progress::inclusive_scan with and
+// without a bar, against their std counterparts.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
+#include "progress_algorithms.hpp"
+
+static volatile double sink_value;
+
+template <typename Run>
+static double measure(const char *name, Run run, double baseline = 0) {
+    // best of a few runs, the differences measured are small
+    double best = 1e9;
+    for (int i = 0; i < 5; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start).count());
+    }
+    if (baseline > 0)
+        printf("%-40s %8.3f s  %+6.2f%%\n", name, best, 100 * (best / baseline - 1));
+    else
+        printf("%-40s %8.3f s\n", name, best);
+    return best;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50000000;
+    unsigned threads = argc > 2 ? std::atoi(argv[2]) : progress::default_threads();
+    printf("%zu elements, %u threads\n", n, threads);
+
+    std::vector<double> input(n);
+    for (size_t i = 0; i < n; ++i)
+        input[i] = (i % 1000) * 0.001;
+    std::vector<double> output(n);
+
+    auto square = [](double x) { return x * x; };
+    auto plus = std::plus<double>();
+
+    measure("std::inner_product", [&] {
+        sink_value = std::inner_product(input.begin(), input.end(), input.begin(), 0.0);
+    });
+    double base = measure("transform_reduce, no bar", [&] {
+        sink_value = progress::transform_reduce(input.begin(), input.end(), 0.0,
+                                                plus, square, nullptr, threads);
+    });
+    measure("transform_reduce", [&] {
+        std::ostringstream sink;
+        ProgressBar bar(n, "reduce", sink);
+        sink_value = progress::transform_reduce(input.begin(), input.end(), 0.0,
+                                                plus, square, &bar, threads);
+    }, base);
+
+    measure("std::partial_sum", [&] {
+        std::partial_sum(input.begin(), input.end(), output.begin());
+    });
+    base = measure("inclusive_scan, no bar", [&] {
+        progress::inclusive_scan(input.begin(), input.end(), output.begin(),
+                                 plus, nullptr, threads);
+    });
+    measure("inclusive_scan", [&] {
+        std::ostringstream sink;
+        ProgressBar bar(n, "scan", sink);
+        progress::inclusive_scan(input.begin(), input.end(), output.begin(),
+                                 plus, &bar, threads);
+    }, base);
+    return 0;
+}
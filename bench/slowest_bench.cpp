@@ -0,0 +1,87 @@
+// Cost of tracking the slowest items of a run: progress::SlowestItems
+// against a priority queue shared under a mutex.
+//
+//     bench/slowest_bench [items] [threads] [k]
+//
+// Durations are drawn from an exponential distribution, labels are the
+// item indexes formatted once beforehand.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "progress_slowest.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+
+static double run(size_t items, unsigned threads, const std::function<void(size_t)> &record) {
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+        workers.emplace_back([&, t] {
+            for (size_t i = t; i < items; i += threads)
+                record(i);
+        });
+    for (std::thread &worker : workers)
+        worker.join();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / items;
+}
+
+int main(int argc, char **argv) {
+    size_t items = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+    unsigned threads = argc > 2 ? atoi(argv[2]) : 4;
+    size_t k = argc > 3 ? strtoull(argv[3], nullptr, 10) : 10;
+
+    std::mt19937_64 random(1);
+    std::exponential_distribution<double> duration(100);
+    std::vector<double> seconds(items);
+    std::vector<std::string> labels(items);
+    for (size_t i = 0; i < items; ++i) {
+        seconds[i] = duration(random);
+        labels[i] = "item-" + std::to_string(i);
+    }
+
+    double slowest_ns, shared_ns, slowest_top, shared_top;
+    {
+        std::ostringstream sink, report;
+        ProgressBar bar(items, "items", sink);
+        progress::SlowestItems slowest(bar, k, report);
+        slowest_ns = run(items, threads, [&](size_t i) { slowest.Record(seconds[i], labels[i]); });
+        slowest_top = slowest.Top().front().seconds;
+    }
+
+    {
+        // a min-heap of the k slowest, every item takes the lock
+        typedef std::pair<double, std::string> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        std::mutex mu;
+        shared_ns = run(items, threads, [&](size_t i) {
+            std::lock_guard<std::mutex> lock(mu);
+            if (heap.size() < k) {
+                heap.push(Entry(seconds[i], labels[i]));
+            } else if (seconds[i] > heap.top().first) {
+                heap.pop();
+                heap.push(Entry(seconds[i], labels[i]));
+            }
+        });
+        while (heap.size() > 1)
+            heap.pop();
+        shared_top = heap.top().first;
+    }
+
+    printf("%-32s %8.1f ns/item  slowest %.3fs\n", "SlowestItems", slowest_ns, slowest_top);
+    printf("%-32s %8.1f ns/item  slowest %.3fs\n", "priority_queue under a mutex", shared_ns,
+           shared_top);
+    return 0;
+}
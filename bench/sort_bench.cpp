@@ -0,0 +1,75 @@
+// progress::sort against std::sort and, when the standard library
+// provides it, std::sort(std::execution::par, ...), on random values then
+// on 4 distinct values, which gives samplesort runs of equal splitters.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<execution>) && __cplusplus >= 201703L
+#include <execution>
+#define HAVE_EXECUTION 1
+#endif
+#endif
+
+#include "progress_algorithms.hpp"
+
+template <typename Sort>
+static void measure(const char *name, const std::vector<uint64_t> &input, Sort sort) {
+    std::vector<uint64_t> data = input;
+    auto start = std::chrono::steady_clock::now();
+    sort(data);
+    double seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start).count();
+    printf("%-36s %8.3f s  %s\n", name, seconds,
+           std::is_sorted(data.begin(), data.end()) ? "" : "NOT SORTED");
+}
+
+static void run(const std::vector<uint64_t> &input) {
+    measure("std::sort", input, [](std::vector<uint64_t> &v) {
+        std::sort(v.begin(), v.end());
+    });
+#ifdef HAVE_EXECUTION
+    measure("std::sort(par)", input, [](std::vector<uint64_t> &v) {
+        std::sort(std::execution::par, v.begin(), v.end());
+    });
+#endif
+    measure("progress::sort, no bar", input, [](std::vector<uint64_t> &v) {
+        progress::sort(v.begin(), v.end(), std::less<uint64_t>(), nullptr);
+    });
+    measure("progress::sort", input, [](std::vector<uint64_t> &v) {
+        std::ostringstream sink;
+        ProgressBar bar(v.size(), "sort", sink);
+        progress::sort(v.begin(), v.end(), bar);
+    });
+    // forces the parallel path on machines with few cores
+    measure("progress::sort, 8 threads", input, [](std::vector<uint64_t> &v) {
+        std::ostringstream sink;
+        ProgressBar bar(v.size(), "sort", sink);
+        progress::sort(v.begin(), v.end(), std::less<uint64_t>(), &bar, 8);
+    });
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50000000;
+    unsigned threads = progress::default_threads();
+    printf("%zu elements, %u threads\n", n, threads);
+
+    std::vector<uint64_t> input(n);
+    std::mt19937_64 random(42);
+    for (uint64_t &value : input)
+        value = random();
+    run(input);
+
+    printf("4 distinct values\n");
+    for (uint64_t &value : input)
+        value = random() % 4;
+    run(input);
+    return 0;
+}
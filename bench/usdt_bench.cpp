@@ -0,0 +1,47 @@
+// Overhead of the USDT probes: build once with probes and once with
+// -DPROGRESS_BAR_NO_USDT (bench/usdt_bench_noprobe) and compare.
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+#include "progress_bar.hpp"
+#include "progress_trace.hpp"
+
+template <typename Loop>
+static void measure(const char *name, uint64_t iterations, Loop loop) {
+    auto start = std::chrono::steady_clock::now();
+    loop();
+    double seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start).count();
+    printf("%-28s %8.3f s  %7.2f ns/increment\n",
+           name, seconds, seconds * 1e9 / iterations);
+}
+
+int main() {
+#ifdef PROGRESS_BAR_USDT
+    printf("USDT probes compiled in\n");
+#else
+    printf("USDT probes compiled out\n");
+#endif
+
+    // increments only, with the default 1000 frames per bar
+    const uint64_t kIncrements = 100000000;
+    measure("increments", kIncrements, [&] {
+        std::ostringstream sink;
+        ProgressBar bar(kIncrements, "increments", sink);
+        for (uint64_t i = 0; i < kIncrements; ++i)
+            ++bar;
+    });
+
+    // a frame per increment, the worst case for the render probes
+    const uint64_t kFrames = 200000;
+    measure("frame per increment", kFrames, [&] {
+        std::ostringstream sink;
+        ProgressBar bar(kFrames, "frames", sink);
+        bar.SetFrequencyUpdate(1);
+        for (uint64_t i = 0; i < kFrames; ++i)
+            ++bar;
+    });
+    return 0;
+}
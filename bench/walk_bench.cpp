@@ -0,0 +1,124 @@
+// Time to the exact number of files of a tree: a serial
+// std::filesystem::recursive_directory_iterator scan against
+// progress::DirectoryWalker, then how early the walker knows the total
+// when visiting the files takes time.
+//
+//     bench/walk_bench [directory]
+//
+// Without a directory, a random tree of about 100k files is created in
+// /tmp/walk_bench and removed afterwards.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "progress_walk.hpp"
+
+namespace fs = std::filesystem;
+
+typedef std::chrono::steady_clock Clock;
+
+
+static double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// uneven fan-outs, as in real trees, so that the estimate has work to do
+static void create_tree(const std::string &root) {
+    std::mt19937 random(42);
+    fs::create_directories(root);
+    for (int a = 0; a < 20; ++a) {
+        std::string level1 = root + "/" + std::to_string(a);
+        fs::create_directory(level1);
+        int directories = random() % 40;
+        for (int b = 0; b < directories; ++b) {
+            std::string level2 = level1 + "/" + std::to_string(b);
+            fs::create_directory(level2);
+            int files = (random() % 8 == 0) ? 2000 : random() % 40;
+            for (int c = 0; c < files; ++c)
+                close(open((level2 + "/" + std::to_string(c)).c_str(),
+                           O_WRONLY | O_CREAT, 0644));
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string root = argc > 1 ? argv[1] : "/tmp/walk_bench";
+    bool created = argc < 2;
+    if (created)
+        create_tree(root);
+
+    Clock::time_point start = Clock::now();
+    uint64_t files = 0;
+    std::error_code error;
+    for (const fs::directory_entry &entry : fs::recursive_directory_iterator(root))
+        if (entry.is_symlink(error) || !entry.is_directory(error))
+            ++files;
+    printf("%-44s %8.3f s  %llu files\n", "recursive_directory_iterator",
+           seconds_since(start), static_cast<unsigned long long>(files));
+
+    for (unsigned threads : {1u, 4u}) {
+        progress::WalkOptions options;
+        options.threads = threads;
+        std::ostringstream sink;
+        ProgressBar bar(0, "walk", sink);
+        progress::DirectoryWalker walker(root, &bar, options);
+        start = Clock::now();
+        walker.Run([](const std::string &) {});
+        std::string name = "DirectoryWalker, " + std::to_string(threads) + " threads";
+        printf("%-44s %8.3f s  %llu files\n", name.c_str(), seconds_since(start),
+               static_cast<unsigned long long>(walker.Discovered()));
+    }
+
+    // visiting costs 20us per file, the total is sampled every millisecond
+    progress::WalkOptions options;
+    options.estimate_probes = 200;
+    std::ostringstream sink;
+    ProgressBar bar(0, "walk", sink);
+    progress::DirectoryWalker walker(root, &bar, options);
+    std::atomic<bool> done(false);
+    double first_estimate_s = -1, complete_s = -1;
+    uint64_t first_estimate = 0;
+    start = Clock::now();
+    std::thread monitor([&] {
+        while (!done && complete_s < 0) {
+            if (first_estimate_s < 0 && walker.Estimate()) {
+                first_estimate_s = seconds_since(start);
+                first_estimate = walker.Estimate();
+            }
+            if (walker.ScanComplete())
+                complete_s = seconds_since(start);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    walker.Run([](const std::string &) {
+        Clock::time_point until = Clock::now() + std::chrono::microseconds(20);
+        while (Clock::now() < until) {}
+    });
+    double run_s = seconds_since(start);
+    done = true;
+    monitor.join();
+
+    uint64_t exact = walker.Discovered();
+    printf("with 20us of work per file, %u threads:\n", std::thread::hardware_concurrency());
+    printf("  first estimate   %8.3f s  %llu files (%+.1f%%)\n", first_estimate_s,
+           static_cast<unsigned long long>(first_estimate),
+           exact ? 100.0 * (double(first_estimate) / exact - 1) : 0.0);
+    printf("  final estimate              %llu files (%+.1f%%)\n",
+           static_cast<unsigned long long>(walker.Estimate()),
+           exact ? 100.0 * (double(walker.Estimate()) / exact - 1) : 0.0);
+    printf("  exact total      %8.3f s\n", complete_s);
+    printf("  all visited      %8.3f s\n", run_s);
+
+    if (created)
+        fs::remove_all(root);
+    return 0;
+}
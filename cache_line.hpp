@@ -0,0 +1,55 @@
+#ifndef _CACHE_LINE_
+#define _CACHE_LINE_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+
+const size_t kCacheLineSize = 64;
+
+// A fixed number of T, for T declared alignas(kCacheLineSize) so that
+// each element starts a cache line and values written by different
+// threads never share one.
+//
+// Before C++17, new and std::vector only guarantee the alignment of
+// std::max_align_t, so the storage is over-allocated by a line and the
+// elements are constructed in place from its first line boundary.
+template <typename T>
+class CacheLineArray {
+    static_assert(alignof(T) % kCacheLineSize == 0,
+                  "CacheLineArray: the type must be aligned on a cache line");
+
+  public:
+    explicit CacheLineArray(size_t size)
+          : storage_(new char[size * sizeof(T) + kCacheLineSize]) {
+        void *data = storage_.get();
+        size_t space = size * sizeof(T) + kCacheLineSize;
+        data_ = static_cast<T *>(std::align(kCacheLineSize, size * sizeof(T), data, space));
+        for (; size_ < size; ++size_)
+            new (data_ + size_) T();
+    }
+
+    ~CacheLineArray() {
+        for (size_t i = size_; i-- > 0;)
+            data_[i].~T();
+    }
+
+    size_t size() const { return size_; }
+    T &operator[](size_t i) { return data_[i]; }
+    const T &operator[](size_t i) const { return data_[i]; }
+    T *begin() { return data_; }
+    T *end() { return data_ + size_; }
+    const T *begin() const { return data_; }
+    const T *end() const { return data_ + size_; }
+
+  private:
+    CacheLineArray(const CacheLineArray &) = delete;
+    CacheLineArray& operator=(const CacheLineArray &) = delete;
+
+    std::unique_ptr<char[]> storage_;
+    T *data_;
+    size_t size_ = 0;
+};
+
+#endif // _CACHE_LINE_
@@ -21,6 +21,7 @@ int main() {
 		ProgressBar bar2(n, "Example 2");
 		bar2.SetFrequencyUpdate(10);
 		bar2.SetStyle('|','-');
+		bar2.SetSparkline(10);
 		//bar2.SetStyle("\u2588", "-"); for linux
 		for (int i = 1; i <= n; ++i) {
 			bar2 += 1;
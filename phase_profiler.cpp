@@ -0,0 +1,194 @@
+#include "phase_profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifdef _WINDOWS
+#include <process.h>
+#define getpid _getpid
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+const size_t PhaseProfiler::kNoPhase;
+
+namespace {
+
+struct PhaseRecord {
+    std::string name;
+    size_t parent;
+    uint64_t total;
+    uint64_t items;
+    std::chrono::steady_clock::time_point created;
+    std::chrono::steady_clock::time_point ended;
+    std::chrono::system_clock::time_point completed;
+    double active_s;
+    bool is_completed;
+    bool is_ended;
+};
+
+} // namespace
+
+static std::atomic<bool> profiler_enabled(false);
+static std::mutex profiler_mu;
+// a deque keeps the records in place while new phases are appended
+static std::deque<PhaseRecord> phases;
+static std::string collapsed_output;
+// forked children inherit the atexit handler, only the profiled process reports
+static int profiled_pid = 0;
+// innermost live phases of the current thread
+static thread_local std::vector<size_t> open_phases;
+
+
+void PhaseProfiler::Enable(const std::string &collapsed_path) {
+    std::lock_guard<std::mutex> lock(profiler_mu);
+
+    collapsed_output = collapsed_path;
+    profiled_pid = getpid();
+    if (!profiler_enabled.exchange(true)) {
+        std::atexit(&PhaseProfiler::AtExit);
+#ifndef _WINDOWS
+        // bars are created and destroyed in forked children too, which
+        // must not inherit the lock held by another thread
+        pthread_atfork([] { profiler_mu.lock(); },
+                       [] { profiler_mu.unlock(); },
+                       [] { new (&profiler_mu) std::mutex; });
+#endif
+    }
+}
+
+bool PhaseProfiler::Enabled() {
+    return profiler_enabled.load(std::memory_order_relaxed);
+}
+
+size_t PhaseProfiler::Begin(const std::string &name, uint64_t total) {
+    std::lock_guard<std::mutex> lock(profiler_mu);
+
+    PhaseRecord record;
+    record.name = name.empty() ? "(unnamed)" : name;
+    // ';' separates frames in collapsed stacks
+    std::replace(record.name.begin(), record.name.end(), ';', ':');
+    record.parent = open_phases.empty() ? kNoPhase : open_phases.back();
+    record.total = total;
+    record.items = 0;
+    record.created = std::chrono::steady_clock::now();
+    record.active_s = 0;
+    record.is_completed = false;
+    record.is_ended = false;
+    phases.push_back(record);
+
+    open_phases.push_back(phases.size() - 1);
+    return phases.size() - 1;
+}
+
+// a bar whose total is raised past its progress completes again later
+void PhaseProfiler::Complete(size_t phase) {
+    std::lock_guard<std::mutex> lock(profiler_mu);
+
+    phases[phase].completed = std::chrono::system_clock::now();
+    phases[phase].is_completed = true;
+}
+
+void PhaseProfiler::End(size_t phase, uint64_t items, uint64_t total,
+                        std::chrono::system_clock::time_point first_increment) {
+    std::lock_guard<std::mutex> lock(profiler_mu);
+
+    PhaseRecord &record = phases[phase];
+    record.ended = std::chrono::steady_clock::now();
+    record.items = items;
+    record.total = total;
+    record.is_ended = true;
+    if (items) {
+        auto last = record.is_completed ? record.completed
+                                        : std::chrono::system_clock::now();
+        record.active_s = std::chrono::duration<double>(last - first_increment).count();
+    }
+
+    // bars are usually destroyed in reverse order, but do not rely on it
+    auto open = std::find(open_phases.rbegin(), open_phases.rend(), phase);
+    if (open != open_phases.rend())
+        open_phases.erase(std::next(open).base());
+}
+
+// wall time of a phase, up to now if its bar is still alive
+static double wall_seconds(const PhaseRecord &record) {
+    auto end = record.is_ended ? record.ended : std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - record.created).count();
+}
+
+static std::string phase_path(size_t phase, const char *separator) {
+    std::string path = phases[phase].name;
+    for (size_t p = phases[phase].parent; p != PhaseProfiler::kNoPhase; p = phases[p].parent)
+        path = phases[p].name + separator + path;
+    return path;
+}
+
+void PhaseProfiler::Report(std::ostream &os) {
+    std::lock_guard<std::mutex> lock(profiler_mu);
+
+    std::vector<size_t> order(phases.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [](size_t a, size_t b) {
+        return wall_seconds(phases[a]) > wall_seconds(phases[b]);
+    });
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-40s %10s %10s %12s %14s\n",
+             "phase", "wall (s)", "active (s)", "items", "rate (/s)");
+    os << line;
+    for (size_t i : order) {
+        const PhaseRecord &record = phases[i];
+        double rate = record.active_s > 0 ? record.items / record.active_s : 0;
+        snprintf(line, sizeof(line), "%-40s %10.3f %10.3f %12llu %14.1f%s\n",
+                 phase_path(i, " > ").c_str(), wall_seconds(record), record.active_s,
+                 static_cast<unsigned long long>(record.items), rate,
+                 record.items == record.total ? "" : " (incomplete)");
+        os << line;
+    }
+    os << std::flush;
+}
+
+bool PhaseProfiler::WriteCollapsed(const std::string &path) {
+    std::lock_guard<std::mutex> lock(profiler_mu);
+
+    // self time is the wall time not covered by nested phases
+    std::vector<double> self(phases.size());
+    for (size_t i = 0; i < phases.size(); ++i)
+        self[i] = wall_seconds(phases[i]);
+    for (size_t i = 0; i < phases.size(); ++i)
+        if (phases[i].parent != kNoPhase)
+            self[phases[i].parent] -= wall_seconds(phases[i]);
+
+    std::ofstream out(path, std::ios::trunc);
+    for (size_t i = 0; i < phases.size(); ++i)
+        out << phase_path(i, ";") << ' '
+            << static_cast<uint64_t>(std::max(0.0, self[i]) * 1e6) << '\n';
+    return static_cast<bool>(out);
+}
+
+void PhaseProfiler::AtExit() {
+    if (getpid() != profiled_pid)
+        return;
+
+    std::cerr << "\n";
+    Report(std::cerr);
+
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(profiler_mu);
+        path = collapsed_output;
+    }
+    if (!path.empty() && !WriteCollapsed(path))
+        std::cerr << "PhaseProfiler: cannot write " << path << std::endl;
+}
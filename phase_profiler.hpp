@@ -0,0 +1,45 @@
+#ifndef _PHASE_PROFILER_
+#define _PHASE_PROFILER_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+
+// Phase profiler built on bar lifetimes.
+//
+// Once enabled, every ProgressBar is recorded as a phase: its lifetime,
+// the time between its first increment and its completion, its item
+// count and the phase it is nested in, i.e. the innermost bar still
+// alive on the same thread when it was created. At exit a summary table
+// sorted by wall time is printed on stderr, and collapsed stacks for
+// flame graph tools are written if a path was given.
+//
+// A record is allocated when a bar is created; completion and
+// destruction only fill it in.
+class PhaseProfiler {
+  public:
+    static const size_t kNoPhase = static_cast<size_t>(-1);
+
+    static void Enable(const std::string &collapsed_path = "");
+    static bool Enabled();
+
+    // prints the phases sorted by decreasing wall time
+    static void Report(std::ostream &os);
+    // writes "outer;inner self_microseconds" lines
+    static bool WriteCollapsed(const std::string &path);
+
+    // hooks called by ProgressBar
+    static size_t Begin(const std::string &name, uint64_t total);
+    static void Complete(size_t phase);
+    // |total| is the final one, the bar may have changed it since Begin
+    static void End(size_t phase, uint64_t items, uint64_t total,
+                    std::chrono::system_clock::time_point first_increment);
+
+  private:
+    static void AtExit();
+};
+
+#endif // _PHASE_PROFILER_
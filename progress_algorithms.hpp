@@ -0,0 +1,493 @@
+#ifndef _PROGRESS_ALGORITHMS_
+#define _PROGRESS_ALGORITHMS_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cache_line.hpp"
+#include "progress_bar.hpp"
+
+
+// Parallel algorithms reporting their progress to a ProgressBar.
+//
+// The algorithms estimate their total amount of work up front, in
+// abstract units, and report completed units in coarse steps. The units
+// are scaled to whatever remains of the bar total, which is exactly
+// reached when the algorithm returns.
+namespace progress {
+
+// Scales work units to the remaining bar total, from several threads.
+class WorkReporter {
+  public:
+    WorkReporter(ProgressBar *bar, double total_units)
+          : bar_(bar), total_units_(std::max(total_units, 1.0)) {
+        if (bar_) {
+            ProgressBar::Snapshot snapshot = bar_->GetSnapshot();
+            bar_units_ = snapshot.total_cost - snapshot.cost;
+        }
+    }
+
+    void Report(double units) {
+        if (!bar_)
+            return;
+
+        // the estimate may be exceeded, the last unit is kept for Finish()
+        uint64_t done = done_.fetch_add(static_cast<uint64_t>(units))
+                      + static_cast<uint64_t>(units);
+        uint64_t target = static_cast<uint64_t>(
+                std::min(done / total_units_, 1.0) * bar_units_);
+        target = std::min(target, bar_units_ ? bar_units_ - 1 : 0);
+        Advance(target);
+    }
+
+    void Finish() {
+        if (bar_)
+            Advance(bar_units_);
+    }
+
+  private:
+    void Advance(uint64_t target) {
+        uint64_t reported = reported_.load();
+        while (reported < target) {
+            if (reported_.compare_exchange_weak(reported, target)) {
+                *bar_ += target - reported;
+                return;
+            }
+        }
+    }
+
+    ProgressBar *bar_;
+    double total_units_;
+    uint64_t bar_units_ = 0;
+    std::atomic<uint64_t> done_ = {0};
+    std::atomic<uint64_t> reported_ = {0};
+};
+
+inline unsigned default_threads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// runs f(0) .. f(threads - 1) concurrently, f(0) on the calling thread
+template <typename F>
+void run_on_threads(unsigned threads, F f) {
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t)
+        workers.emplace_back(f, t);
+    f(0);
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+inline double sort_units(double n) {
+    return n * std::log2(std::max(n, 2.0));
+}
+
+namespace detail {
+
+const size_t kSerialSortSize = 1 << 16;
+const size_t kOversampling = 64;
+// also the number of progress steps of the final phase
+const size_t kMinBuckets = 64;
+
+// Storage for |size| elements, which are constructed in place and all
+// destroyed with it, so that T need not be default-constructible.
+template <typename T>
+class UninitializedBuffer {
+  public:
+    explicit UninitializedBuffer(size_t size)
+          : data_(std::allocator<T>().allocate(size)), size_(size) {}
+
+    ~UninitializedBuffer() {
+        for (size_t i = 0; i < size_; ++i)
+            data_[i].~T();
+        std::allocator<T>().deallocate(data_, size_);
+    }
+
+    T *data() { return data_; }
+
+  private:
+    UninitializedBuffer(const UninitializedBuffer &) = delete;
+    UninitializedBuffer& operator=(const UninitializedBuffer &) = delete;
+
+    T *data_;
+    size_t size_;
+};
+
+// Samplesort: splitters are picked from a sorted sample, every thread
+// counts then scatters its chunk into per-bucket ranges of a buffer, and
+// the buckets are sorted independently and moved back. Needs one buffer
+// of the size of the input.
+//
+// A value equal to a run of equal splitters may go to any bucket from
+// the first of them to the one after the last, and is spread over them
+// by its position, so that many duplicates are still sorted in parallel.
+// The buckets between equal splitters hold a single value, and are not
+// sorted.
+template <typename RandomIt, typename Compare>
+void sample_sort(RandomIt first, RandomIt last, Compare comp,
+                 unsigned threads, WorkReporter &reporter) {
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+    const size_t n = last - first;
+    const size_t buckets = std::max<size_t>(threads * 4, kMinBuckets);
+
+    // splitters from a regular sample of the input
+    std::vector<T> sample;
+    size_t sample_size = std::min(n, buckets * kOversampling);
+    for (size_t i = 0; i < sample_size; ++i)
+        sample.push_back(first[i * (n / sample_size)]);
+    std::sort(sample.begin(), sample.end(), comp);
+    std::vector<T> splitters;
+    for (size_t b = 1; b < buckets; ++b)
+        splitters.push_back(sample[b * sample_size / buckets]);
+
+    // bucket b is between the splitters b - 1 and b
+    auto equal_splitters = [&](size_t b) {
+        return b > 0 && b < splitters.size() && !comp(splitters[b - 1], splitters[b]);
+    };
+    bool has_equal_splitters = false;
+    for (size_t b = 1; b < splitters.size(); ++b)
+        has_equal_splitters |= equal_splitters(b);
+
+    auto bucket_of = [&](const T &value, size_t position) {
+        size_t b = std::upper_bound(splitters.begin(), splitters.end(), value, comp)
+                 - splitters.begin();
+        if (!has_equal_splitters || b == 0 || comp(splitters[b - 1], value))
+            return b;
+        size_t equal = b - (std::lower_bound(splitters.begin(), splitters.begin() + b,
+                                             value, comp) - splitters.begin());
+        return b - position % equal;
+    };
+
+    // count the elements of every bucket in every chunk
+    const size_t chunk = (n + threads - 1) / threads;
+    std::vector<std::vector<size_t>> counts(threads, std::vector<size_t>(buckets));
+    run_on_threads(threads, [&](unsigned t) {
+        size_t begin = std::min(n, t * chunk);
+        size_t end = std::min(n, (t + 1) * chunk);
+        for (size_t i = begin; i != end; ++i)
+            ++counts[t][bucket_of(first[i], i)];
+        reporter.Report(end - begin);
+    });
+
+    // bucket b of chunk t starts after all the smaller buckets, and after
+    // bucket b of the previous chunks
+    std::vector<std::vector<size_t>> offsets(threads, std::vector<size_t>(buckets));
+    std::vector<size_t> bucket_begin(buckets + 1);
+    size_t offset = 0;
+    for (size_t b = 0; b < buckets; ++b) {
+        bucket_begin[b] = offset;
+        for (unsigned t = 0; t < threads; ++t) {
+            offsets[t][b] = offset;
+            offset += counts[t][b];
+        }
+    }
+    bucket_begin[buckets] = n;
+
+    UninitializedBuffer<T> buffer(n);
+    run_on_threads(threads, [&](unsigned t) {
+        size_t begin = std::min(n, t * chunk);
+        size_t end = std::min(n, (t + 1) * chunk);
+        for (size_t i = begin; i != end; ++i)
+            new (buffer.data() + offsets[t][bucket_of(first[i], i)]++) T(std::move(first[i]));
+        reporter.Report(end - begin);
+    });
+
+    // largest buckets first, for a better balance between threads
+    std::vector<size_t> order(buckets);
+    for (size_t b = 0; b < buckets; ++b)
+        order[b] = b;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return bucket_begin[a + 1] - bucket_begin[a] > bucket_begin[b + 1] - bucket_begin[b];
+    });
+
+    std::atomic<size_t> next(0);
+    run_on_threads(threads, [&](unsigned) {
+        for (size_t i = next++; i < buckets; i = next++) {
+            size_t b = order[i];
+            size_t size = bucket_begin[b + 1] - bucket_begin[b];
+            T *begin = buffer.data() + bucket_begin[b];
+            if (!equal_splitters(b))
+                std::sort(begin, begin + size, comp);
+            std::move(begin, begin + size, first + bucket_begin[b]);
+            reporter.Report(sort_units(size) + size);
+        }
+    });
+}
+
+// Single-threaded: quicksort partitioning down to about kMinBuckets
+// ranges, which are then sorted by std::sort. Costs about one partition
+// pass per level over std::sort alone, and needs no buffer.
+template <typename RandomIt, typename Compare>
+void partition_sort(RandomIt first, RandomIt last, Compare comp,
+                    WorkReporter &reporter) {
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+    const size_t leaf = std::max<size_t>((last - first) / kMinBuckets, kSerialSortSize);
+    // bad pivots leave large ranges to std::sort, which is introsort anyway
+    const int max_depth = 2 * static_cast<int>(std::log2(kMinBuckets));
+
+    std::vector<std::pair<std::pair<RandomIt, RandomIt>, int>> pending;
+    pending.push_back(std::make_pair(std::make_pair(first, last), 0));
+    while (!pending.empty()) {
+        RandomIt begin = pending.back().first.first;
+        RandomIt end = pending.back().first.second;
+        int depth = pending.back().second;
+        pending.pop_back();
+
+        size_t size = end - begin;
+        if (size <= leaf || depth >= max_depth) {
+            std::sort(begin, end, comp);
+            reporter.Report(sort_units(size));
+            continue;
+        }
+
+        // median of three as the pivot
+        RandomIt middle = begin + size / 2;
+        if (comp(*middle, *begin))
+            std::iter_swap(middle, begin);
+        if (comp(*(end - 1), *middle)) {
+            std::iter_swap(end - 1, middle);
+            if (comp(*middle, *begin))
+                std::iter_swap(middle, begin);
+        }
+        T pivot = *middle;
+        RandomIt lower = std::partition(begin, end,
+                [&](const T &value) { return comp(value, pivot); });
+        // when the pivot is the smallest value, the values equal to it are
+        // split off so that the range always shrinks
+        RandomIt upper = lower;
+        if (lower == begin)
+            upper = std::partition(lower, end,
+                    [&](const T &value) { return !comp(pivot, value); });
+        reporter.Report(size);
+
+        pending.push_back(std::make_pair(std::make_pair(begin, lower), depth + 1));
+        pending.push_back(std::make_pair(std::make_pair(upper, end), depth + 1));
+    }
+}
+
+} // namespace detail
+
+namespace detail {
+
+// about half of a typical L2 cache
+const size_t kBlockBytes = 128 * 1024;
+// reports per worker over a whole pass
+const size_t kWorkerReports = 256;
+
+template <typename T>
+size_t block_size() {
+    return std::max<size_t>(1, kBlockBytes / sizeof(T));
+}
+
+// Runs f(begin, end, worker) over blocks of [0, n), claimed one at a time
+// by |threads| workers. Every worker keeps its completed items in a local
+// counter, and reports them about kWorkerReports times per pass.
+template <typename F>
+void for_each_block(size_t n, size_t block, unsigned threads,
+                    WorkReporter &reporter, F f) {
+    const size_t blocks = (n + block - 1) / block;
+    const size_t report_every = std::max(block, n / (threads * kWorkerReports));
+    std::atomic<size_t> next(0);
+    run_on_threads(threads, [&](unsigned worker) {
+        size_t pending = 0;
+        for (size_t b = next++; b < blocks; b = next++) {
+            size_t begin = b * block;
+            size_t end = std::min(n, begin + block);
+            f(begin, end, worker);
+            pending += end - begin;
+            if (pending >= report_every) {
+                reporter.Report(pending);
+                pending = 0;
+            }
+        }
+        reporter.Report(pending);
+    });
+}
+
+// Scans [first, last) into d_first, starting from |carry| if |has_carry|,
+// and returns the last sum.
+template <typename RandomIt, typename OutputIt, typename BinaryOp, typename V>
+V scan_block(RandomIt first, RandomIt last, OutputIt d_first, BinaryOp op,
+             V carry, bool has_carry) {
+    V sum = has_carry ? op(carry, *first) : *first;
+    *d_first = sum;
+    while (++first != last) {
+        sum = op(sum, *first);
+        *++d_first = sum;
+    }
+    return sum;
+}
+
+inline unsigned block_threads(unsigned threads, size_t n, size_t block) {
+    return static_cast<unsigned>(std::max<size_t>(1,
+            std::min<size_t>(threads, (n + block - 1) / block)));
+}
+
+} // namespace detail
+
+// Reduces transform(x) over [first, last) into |init|, with up to
+// |threads| threads reporting to |bar|. As with std::transform_reduce,
+// |reduce| must be associative and commutative.
+template <typename RandomIt, typename T, typename BinaryReduce, typename UnaryTransform>
+T transform_reduce(RandomIt first, RandomIt last, T init,
+                   BinaryReduce reduce, UnaryTransform transform,
+                   ProgressBar *bar, unsigned threads = default_threads()) {
+    typedef typename std::iterator_traits<RandomIt>::value_type V;
+    const size_t n = last - first;
+    const size_t block = detail::block_size<V>();
+    threads = detail::block_threads(threads, n, block);
+
+    // one partial result per worker, on its own cache line
+    struct alignas(kCacheLineSize) Partial {
+        T value;
+        bool empty = true;
+    };
+    CacheLineArray<Partial> partials(threads);
+
+    WorkReporter reporter(bar, n);
+    detail::for_each_block(n, block, threads, reporter,
+                           [&](size_t begin, size_t end, unsigned worker) {
+        Partial &partial = partials[worker];
+        size_t i = begin;
+        if (partial.empty) {
+            partial.value = transform(first[i++]);
+            partial.empty = false;
+        }
+        T value = partial.value;
+        for (; i < end; ++i)
+            value = reduce(value, transform(first[i]));
+        partial.value = value;
+    });
+    reporter.Finish();
+
+    for (const Partial &partial : partials)
+        if (!partial.empty)
+            init = reduce(init, partial.value);
+    return init;
+}
+
+template <typename RandomIt, typename T, typename BinaryReduce, typename UnaryTransform>
+T transform_reduce(RandomIt first, RandomIt last, T init,
+                   BinaryReduce reduce, UnaryTransform transform, ProgressBar &bar) {
+    return transform_reduce(first, last, init, reduce, transform, &bar);
+}
+
+// Writes the inclusive prefix sums of [first, last) under |op| to
+// [d_first, ...), with up to |threads| threads reporting to |bar|. |op|
+// must be associative. In parallel, the blocks are reduced, their sums
+// are scanned, and the blocks are scanned again from their offsets, so
+// every input element is read twice.
+template <typename RandomIt, typename OutputIt, typename BinaryOp>
+OutputIt inclusive_scan(RandomIt first, RandomIt last, OutputIt d_first,
+                        BinaryOp op, ProgressBar *bar,
+                        unsigned threads = default_threads()) {
+    typedef typename std::iterator_traits<RandomIt>::value_type V;
+    const size_t n = last - first;
+    const size_t block = detail::block_size<V>();
+    threads = detail::block_threads(threads, n, block);
+
+    if (threads < 2) {
+        WorkReporter reporter(bar, n);
+        // a plain loop, a carry captured by the block function would be
+        // kept in memory and stored at every element
+        V carry = V();
+        size_t reported = 0;
+        for (size_t begin = 0; begin < n; begin += block) {
+            size_t end = std::min(n, begin + block);
+            carry = detail::scan_block(first + begin, first + end, d_first + begin,
+                                       op, carry, begin > 0);
+            if (end - reported >= n / detail::kWorkerReports) {
+                reporter.Report(end - reported);
+                reported = end;
+            }
+        }
+        reporter.Finish();
+        return d_first + n;
+    }
+
+    WorkReporter reporter(bar, 2.0 * n);
+    std::vector<V> sums((n + block - 1) / block);
+    detail::for_each_block(n, block, threads, reporter,
+                           [&](size_t begin, size_t end, unsigned) {
+        V sum = first[begin];
+        for (size_t i = begin + 1; i < end; ++i)
+            sum = op(sum, first[i]);
+        sums[begin / block] = sum;
+    });
+    for (size_t b = 1; b < sums.size(); ++b)
+        sums[b] = op(sums[b - 1], sums[b]);
+
+    detail::for_each_block(n, block, threads, reporter,
+                           [&](size_t begin, size_t end, unsigned) {
+        detail::scan_block(first + begin, first + end, d_first + begin, op,
+                           begin ? sums[begin / block - 1] : V(), begin > 0);
+    });
+    reporter.Finish();
+    return d_first + n;
+}
+
+template <typename RandomIt, typename OutputIt, typename BinaryOp>
+OutputIt inclusive_scan(RandomIt first, RandomIt last, OutputIt d_first,
+                        BinaryOp op, ProgressBar &bar) {
+    return inclusive_scan(first, last, d_first, op, &bar);
+}
+
+template <typename RandomIt, typename OutputIt>
+OutputIt inclusive_scan(RandomIt first, RandomIt last, OutputIt d_first,
+                        ProgressBar &bar) {
+    typedef typename std::iterator_traits<RandomIt>::value_type V;
+    return inclusive_scan(first, last, d_first, std::plus<V>(), &bar);
+}
+
+// Sorts [first, last) with up to |threads| threads, reporting to |bar|.
+// Without a bar and with a single thread, this is std::sort.
+template <typename RandomIt, typename Compare>
+void sort(RandomIt first, RandomIt last, Compare comp, ProgressBar *bar,
+          unsigned threads = default_threads()) {
+    const size_t n = last - first;
+    threads = static_cast<unsigned>(std::min<size_t>(threads, n / detail::kSerialSortSize));
+
+    if (!threads || (threads < 2 && !bar)) {
+        WorkReporter reporter(bar, 1);
+        std::sort(first, last, comp);
+        reporter.Finish();
+        return;
+    }
+    if (threads < 2) {
+        WorkReporter reporter(bar, sort_units(n) + n);
+        detail::partition_sort(first, last, comp, reporter);
+        reporter.Finish();
+        return;
+    }
+
+    // counting, scattering, sorting the buckets and moving them back
+    double bucket_size = static_cast<double>(n)
+                       / std::max<size_t>(threads * 4, detail::kMinBuckets);
+    WorkReporter reporter(bar, 3.0 * n + n * std::log2(std::max(bucket_size, 2.0)));
+    detail::sample_sort(first, last, comp, threads, reporter);
+    reporter.Finish();
+}
+
+template <typename RandomIt, typename Compare>
+void sort(RandomIt first, RandomIt last, Compare comp, ProgressBar &bar) {
+    sort(first, last, comp, &bar);
+}
+
+template <typename RandomIt>
+void sort(RandomIt first, RandomIt last, ProgressBar &bar) {
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+    sort(first, last, std::less<T>(), &bar);
+}
+
+} // namespace progress
+
+#endif // _PROGRESS_ALGORITHMS_
@@ -1,4 +1,5 @@
 #include "progress_bar.hpp"
+#include "progress_trace.hpp"
 
 #include <iomanip>
 #include <cmath>
@@ -7,9 +8,18 @@
 #include <chrono>
 #include <ctime>
 #include <sstream>
+#include <new>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 #if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
     #include <unistd.h>
+    #include <pthread.h>
+    #include <fcntl.h>
     #if !defined(_POSIX_VERSION)
         #include <io.h>
     #endif
@@ -22,9 +32,68 @@ const double kTotalPercentage = 100.0;
 const size_t kCharacterWidthPercentage = 7;
 const int kDefaultConsoleWidth = 100;
 const int kMaxBarWidth = 120;
+// seconds of rate history used to estimate the spread of the ETA
+const size_t kRateWindow = 60;
+const size_t kMinRateSamples = 5;
+// z-score of the 10th/90th percentiles of a normal distribution
+const double kZ90 = 1.2816;
+// slots in each chunk of the registry of live bars
+const size_t kRegistryChunkBars = 64;
+// period at which observe mode samples the observed value
+const std::chrono::milliseconds kObserveInterval(100);
+// seconds of rate history behind the throughput of byte mode
+const size_t kThroughputWindow = 5;
+// columns of "999.9 MB/999.9 GB, 999.9 MB/s" beyond those of plain counts
+const size_t kByteCountsWidth = 28;
+// columns of "backlog 9999, in 999.9/s, out 999.9/s, drains in 1m30s"
+// beyond those of an ETA
+const size_t kQueueWidth = 40;
+// columns kept for the value of a gauge, and bytes for its formatting
+const size_t kGaugeWidth = 8;
+const size_t kGaugeTextSize = 64;
+// seconds of rate history behind the rates of a queue
+const size_t kQueueWindow = 3;
+// relative difference under which arrival and service rates are balanced
+const double kQueueBalance = 0.02;
+// queues are logged every this many renderer ticks, once a second
+const unsigned kQueueLogTicks = 10;
 
+namespace {
 
-bool to_terminal(const std::ostream &os) {
+// The registry of live bars, chunks of slots linked as they fill up and
+// never freed: slots are read without locking, even in signal handlers,
+// registry_mu serializes the writers.
+struct RegistryChunk {
+    std::atomic<ProgressBar *> bars[kRegistryChunkBars];
+    std::atomic<RegistryChunk *> next;
+};
+
+} // namespace
+static RegistryChunk registered_bars;
+static std::mutex registry_mu;
+
+// calls |f| on every registered bar
+template <typename F>
+static void for_each_registered(F f) {
+    for (RegistryChunk *chunk = &registered_bars; chunk; chunk = chunk->next.load())
+        for (size_t i = 0; i < kRegistryChunkBars; ++i)
+            if (ProgressBar *bar = chunk->bars[i].load())
+                f(bar);
+}
+
+#ifndef _WINDOWS
+const int kTerminationSignals[] = {SIGINT, SIGTERM};
+static struct sigaction previous_actions[NSIG];
+// termination handlers walking the registry, waited for by unregistering bars
+static std::atomic<int> signal_readers(0);
+
+// set by the status signal, the byte written to the pipe wakes the watcher
+static std::atomic<bool> status_requested(false);
+static int status_pipe[2] = {-1, -1};
+#endif
+
+
+static bool to_terminal(const std::ostream &os) {
 #if _WINDOWS
     if (os.rdbuf() == std::cout.rdbuf() && !_isatty(_fileno(stdout)))
         return false;
@@ -39,44 +108,504 @@ bool to_terminal(const std::ostream &os) {
     return true;
 }
 
+// number of columns taken by an UTF-8 string, assuming no wide characters
+static size_t display_width(const std::string &s) {
+    size_t width = 0;
+    for (char c : s)
+        if ((c & 0xC0) != 0x80)
+            ++width;
+    return width;
+}
+
+static std::string get_progress_summary(double progress_ratio) {
+    std::string buffer = std::string(kCharacterWidthPercentage, ' ');
+
+    // in some implementations, snprintf always appends null terminal character
+    snprintf((char *)buffer.data(), kCharacterWidthPercentage,
+             "%5.1f%%", progress_ratio * kTotalPercentage);
+
+    // erase the last null terminal character
+    buffer.pop_back();
+    return buffer;
+}
+
+// decimal units, as throughputs are usually given in MB/s
+static std::string format_bytes(double bytes) {
+    const char *units[] = {"B", "kB", "MB", "GB", "TB", "PB"};
+    size_t unit = 0;
+    while (bytes >= 999.95 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        bytes /= 1000;
+        ++unit;
+    }
+    char buffer[32];
+    if (unit == 0)
+        snprintf(buffer, sizeof(buffer), "%.0f %s", bytes, units[unit]);
+    else
+        snprintf(buffer, sizeof(buffer), "%.1f %s", bytes, units[unit]);
+    return buffer;
+}
+
+// a printf format with a single conversion, of a long long
+static bool is_gauge_format(const std::string &format) {
+    int conversions = 0;
+    for (size_t i = 0; i < format.size(); ++i) {
+        if (format[i] != '%')
+            continue;
+        if (i + 1 < format.size() && format[i + 1] == '%') {
+            ++i;
+            continue;
+        }
+        size_t j = format.find_first_not_of("-+ #0123456789.", i + 1);
+        if (j == std::string::npos || j + 2 >= format.size()
+                || format.compare(j, 2, "ll") || !strchr("diuxX", format[j + 2]))
+            return false;
+        ++conversions;
+        i = j + 2;
+    }
+    return conversions == 1;
+}
+
+// a relaxed atomic load of a plain integer, what std::atomic_ref does
+static uint64_t load_relaxed(uint64_t &value) {
+#if defined(__cpp_lib_atomic_ref)
+    return std::atomic_ref<uint64_t>(value).load(std::memory_order_relaxed);
+#elif defined(_MSC_VER)
+    // aligned 64-bit loads are atomic on the targets of MSVC
+    return *static_cast<volatile uint64_t *>(&value);
+#else
+    return __atomic_load_n(&value, __ATOMIC_RELAXED);
+#endif
+}
+
+// current time as [YYYY-MM-DD HH:MM:SS.mmm]
+static std::string get_timestamp() {
+    auto now = std::chrono::system_clock::now();
+    std::time_t time = std::chrono::system_clock::to_time_t(now);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                now.time_since_epoch()) % 1000;
+    std::stringstream os;
+    os << std::put_time(std::localtime(&time), "[%F %T.")
+       << std::setfill('0') << std::setw(3) << ms.count() << "]";
+    return os.str();
+}
+
 ProgressBar::ProgressBar(uint64_t total,
                          const std::string &description,
                          std::ostream &out_,
                          bool silent)
-      : silent_(silent), total_(total), description_(description) {
+      : ProgressBar(total, description, out_, silent, false) {}
+
+ProgressBar::ProgressBar(uint64_t total,
+                         const std::string &description,
+                         std::ostream &out_,
+                         bool silent,
+                         bool queue_mode)
+      : silent_(silent), queue_mode_(queue_mode), total_(total),
+        description_(description), key_(description),
+        created_(std::chrono::steady_clock::now()) {
+
+    PROGRESS_PROBE2(create, Id(), total);
+
+    if (PhaseProfiler::Enabled())
+        phase_ = PhaseProfiler::Begin(key_, total);
 
     if (silent_)
         return;
 
     frequency_update = std::max(static_cast<uint64_t>(1), total_ / 1000);
     out = &out_;
+#ifndef _WINDOWS
+    if (out->rdbuf() == std::cout.rdbuf())
+        fd_ = STDOUT_FILENO;
+    else if (out->rdbuf() == std::cerr.rdbuf() || out->rdbuf() == std::clog.rdbuf())
+        fd_ = STDERR_FILENO;
+#endif
 
     if ((logging_mode_ = !to_terminal(*out)))
         *out << description_ << std::endl;
 
     description_.resize(kMessageSize, ' ');
 
+    // a total of 0 is not known yet, the bar is not completed
     ShowProgress(0);
-    if (progress_ == total_)
-        *out << std::endl;
+
+    Register();
+}
+
+ProgressBar::ProgressBar(uint64_t total,
+                         const std::atomic<uint64_t> &counter,
+                         const std::string &description,
+                         std::ostream &out_)
+      : ProgressBar(total, description, out_) {
+    Observe([&counter] { return counter.load(std::memory_order_relaxed); });
+}
+
+ProgressBar::ProgressBar(uint64_t total,
+                         uint64_t &counter,
+                         const std::string &description,
+                         std::ostream &out_)
+      : ProgressBar(total, description, out_) {
+    Observe([&counter] { return load_relaxed(counter); });
+}
+
+ProgressBar::ProgressBar(uint64_t total,
+                         Source source,
+                         const std::string &description,
+                         std::ostream &out_)
+      : ProgressBar(total, description, out_) {
+    Observe(std::move(source));
+}
+
+ProgressBar::ProgressBar(QueueTag,
+                         const std::string &description,
+                         std::ostream &out_)
+      : ProgressBar(0, description, out_, false, true) {
+    start_time_.store(std::chrono::system_clock::now());
+    StartRenderer();
+}
+
+void ProgressBar::Observe(Source source) {
+    source_ = std::move(source);
+    StartRenderer();
+}
+
+// samples the observed value, or draws the queue, every kObserveInterval
+void ProgressBar::StartRenderer() {
+    if (completed_)
+        return;
+
+    observer_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(observer_mu_);
+        for (unsigned tick = 1; !observer_stop_ && !completed_; ++tick) {
+            observer_cv_.wait_for(lock, kObserveInterval);
+            lock.unlock();
+            if (source_)
+                Sample();
+            else if (!logging_mode_ || tick % kQueueLogTicks == 0)
+                ShowProgress(progress_.load(std::memory_order_relaxed));
+            lock.lock();
+        }
+    });
+}
+
+// moves the progress to the observed value, which must not go back
+void ProgressBar::Sample() {
+    uint64_t value = std::min(source_(), total_.load());
+    uint64_t progress = progress_.load(std::memory_order_relaxed);
+    if (value > progress)
+        *this += value - progress;
+}
+
+void ProgressBar::StopObserver() {
+    if (!observer_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(observer_mu_);
+        observer_stop_ = true;
+    }
+    observer_cv_.notify_one();
+    observer_.join();
 }
 
 ProgressBar::~ProgressBar() {
-    if (progress_ != total_) {
+    // the loop is over, its final value completes the bar
+    StopObserver();
+    if (source_ && !detached_)
+        Sample();
+
+    PROGRESS_PROBE3(destroy, Id(), progress_.load(), total_.load());
+    Unregister();
+
+    // the parent process draws the final frame
+    if (detached_)
+        return;
+
+    if (phase_ != PhaseProfiler::kNoPhase)
+        PhaseProfiler::End(phase_, progress_.load(), total_.load(), start_time_.load());
+
+    if (queue_mode_) {
+        // a queue is never completed, its last state is kept
+        ShowProgress(Done());
+        if (!silent_)
+            *out << "\n";
+    } else if (Done() != Total()) {
         // this is not supposed to happen, but may be useful for debugging
-        ShowProgress(progress_);
+        ShowProgress(Done());
         if (!silent_)
             *out << "\n";
+    } else if (!completed_.exchange(true)) {
+        // a total never raised from 0, the run was empty
+        ShowProgress(Done());
+        if (!silent_)
+            *out << "\n";
+    }
+
+    // completed runs are kept as a prior for the next run
+    if (run_history_ && next_curve_point_ == RunHistory::kCurvePoints) {
+        run_.duration = run_.curve[RunHistory::kCurvePoints - 1];
+        run_.total = Total();
+        if (run_.duration > 0) {
+            for (size_t i = 0; i < RunHistory::kCurvePoints; ++i)
+                run_.curve[i] /= run_.duration;
+            run_history_->Record(key_, run_);
+        }
+    }
+}
+
+void ProgressBar::Register() {
+#ifndef _WINDOWS
+    static std::once_flag fork_handlers;
+    std::call_once(fork_handlers, [] {
+        pthread_atfork(&ProgressBar::PrepareFork,
+                       &ProgressBar::AfterForkInParent,
+                       &ProgressBar::AfterForkInChild);
+    });
+#endif
+
+    std::lock_guard<std::mutex> lock(registry_mu);
+
+    RegistryChunk *chunk = &registered_bars;
+    for (;;) {
+        for (size_t i = 0; i < kRegistryChunkBars; ++i) {
+            if (!chunk->bars[i].load()) {
+                chunk->bars[i].store(this);
+                registry_slot_ = &chunk->bars[i];
+                return;
+            }
+        }
+        // value-initialized, its slots are cleared before it is linked
+        if (!chunk->next.load())
+            chunk->next.store(new RegistryChunk());
+        chunk = chunk->next.load();
+    }
+}
+
+void ProgressBar::Unregister() {
+    std::lock_guard<std::mutex> lock(registry_mu);
+
+    if (registry_slot_)
+        registry_slot_->store(nullptr);
+    registry_slot_ = nullptr;
+#ifndef _WINDOWS
+    // A termination handler running on another thread may have loaded
+    // this bar before it was cleared: the bar is not freed before the
+    // handler is done. Handlers raise the count before loading any slot,
+    // so those not counted here no longer see the bar.
+    while (signal_readers.load())
+        std::this_thread::yield();
+#endif
+}
+
+// Quiesces every bar before fork(): holding all the locks guarantees that
+// no thread is in the middle of drawing a frame when the process is copied.
+void ProgressBar::PrepareFork() {
+    registry_mu.lock();
+    for_each_registered([](ProgressBar *bar) { bar->mu_.lock(); });
+}
+
+void ProgressBar::AfterForkInParent() {
+    for_each_registered([](ProgressBar *bar) { bar->mu_.unlock(); });
+    registry_mu.unlock();
+}
+
+// Only the forking thread survives in the child, so the locks are
+// reinitialized rather than unlocked, and the inherited bars keep
+// counting silently so that the final frames are not drawn twice.
+void ProgressBar::AfterForkInChild() {
+    for_each_registered([](ProgressBar *bar) {
+        new (&bar->mu_) std::mutex;
+        bar->detached_.store(true);
+        // the renderer thread was not copied, nothing is left to join
+        if (bar->observer_.joinable()) {
+            new (&bar->observer_) std::thread;
+            new (&bar->observer_mu_) std::mutex;
+            new (&bar->observer_cv_) std::condition_variable;
+        }
+    });
+    new (&registry_mu) std::mutex;
+}
+
+void ProgressBar::InstallSignalHandlers() {
+#ifndef _WINDOWS
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = &ProgressBar::OnTerminationSignal;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+
+    for (int signum : kTerminationSignals) {
+        struct sigaction previous;
+        sigaction(signum, &action, &previous);
+        // installing twice must not chain the handler to itself
+        if (previous.sa_sigaction != &ProgressBar::OnTerminationSignal)
+            previous_actions[signum] = previous;
+    }
+#endif
+}
+
+#ifndef _WINDOWS
+// Everything below runs in a signal handler: no locks, no allocations,
+// no stdio, only atomics and write(2) on stack buffers.
+
+static size_t append_raw(char *buffer, size_t pos, size_t size, const char *s, size_t n) {
+    for (size_t i = 0; i < n && pos < size; ++i)
+        buffer[pos++] = s[i];
+    return pos;
+}
+
+static size_t append_uint(char *buffer, size_t pos, size_t size, uint64_t value) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n > 0 && pos < size)
+        buffer[pos++] = digits[--n];
+    return pos;
+}
+
+void ProgressBar::WriteFinalFrame() const {
+    // a completed bar already drew its final frame
+    if (fd_ < 0 || silent_ || detached_.load() || completed_.load())
+        return;
+
+    char line[256];
+    const size_t size = sizeof(line);
+    size_t pos = 0;
+
+    // erase the half-drawn frame
+    if (!logging_mode_)
+        pos = append_raw(line, pos, size, "\r\x1b[K", 4);
+
+    uint64_t done = weighted_ ? cost_.load() : progress_.load();
+    uint64_t total = weighted_ ? total_cost_ : total_.load();
+    uint64_t permille = total ? static_cast<uint64_t>(1000.0 * done / total) : 0;
+
+    pos = append_raw(line, pos, size, " ", 1);
+    pos = append_raw(line, pos, size, description_.data(), description_.size());
+    pos = append_raw(line, pos, size, " ", 1);
+    pos = append_uint(line, pos, size, permille / 10);
+    pos = append_raw(line, pos, size, ".", 1);
+    pos = append_uint(line, pos, size, permille % 10);
+    pos = append_raw(line, pos, size, "%, ", 3);
+    pos = append_uint(line, pos, size, progress_.load());
+    pos = append_raw(line, pos, size, "/", 1);
+    pos = append_uint(line, pos, size, total_.load());
+    pos = append_raw(line, pos, size, ", interrupted\n", 14);
+
+    ssize_t ignored = write(fd_, line, pos);
+    (void)ignored;
+}
+
+void ProgressBar::OnTerminationSignal(int signum, siginfo_t *info, void *context) {
+    int saved_errno = errno;
+    signal_readers.fetch_add(1);
+    for_each_registered([](const ProgressBar *bar) { bar->WriteFinalFrame(); });
+    signal_readers.fetch_sub(1);
+    errno = saved_errno;
+
+    // chain to the previous disposition
+    const struct sigaction &previous = previous_actions[signum];
+    if (previous.sa_flags & SA_SIGINFO) {
+        previous.sa_sigaction(signum, info, context);
+    } else if (previous.sa_handler == SIG_DFL) {
+        signal(signum, SIG_DFL);
+        raise(signum);
+    } else if (previous.sa_handler != SIG_IGN) {
+        previous.sa_handler(signum);
+    }
+}
+#endif
+
+#ifndef _WINDOWS
+static void on_status_signal(int) {
+    int saved_errno = errno;
+    status_requested.store(true);
+    char byte = 0;
+    ssize_t ignored = write(status_pipe[1], &byte, 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+#endif
+
+void ProgressBar::EnableStatusDump(int signum) {
+#ifndef _WINDOWS
+    static std::once_flag watcher;
+    std::call_once(watcher, [] {
+        if (pipe(status_pipe))
+            return;
+        // a full pipe already guarantees a pending dump
+        fcntl(status_pipe[1], F_SETFL, O_NONBLOCK);
+
+        std::thread([] {
+            char byte;
+            while (read(status_pipe[0], &byte, 1) > 0 || errno == EINTR)
+                if (status_requested.exchange(false))
+                    DumpStatus();
+        }).detach();
+    });
+    if (status_pipe[1] < 0)
+        return;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &on_status_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(signum, &action, nullptr);
+#else
+    (void)signum;
+#endif
+}
+
+void ProgressBar::DumpStatus() {
+    std::lock_guard<std::mutex> lock(registry_mu);
+
+    for_each_registered([](const ProgressBar *bar) { bar->WriteStatus(); });
+}
+
+void ProgressBar::WriteStatus() const {
+    if (silent_ || detached_)
+        return;
+
+    Snapshot snapshot = GetSnapshot();
+
+    std::lock_guard<std::mutex> lock(mu_);
+
+    double progress_ratio = snapshot.total_cost
+                          ? std::min(1.0, static_cast<double>(snapshot.cost) / snapshot.total_cost)
+                          : completed_ || queue_mode_ ? 1.0 : 0.0;
+    std::stringstream os;
+    os << get_timestamp() << "\t" << key_ << ": "
+       << get_progress_summary(progress_ratio) << ", ";
+    if (byte_mode_)
+        os << FormatCounts(snapshot.progress);
+    else
+        os << snapshot.progress << "/" << snapshot.total
+           << ", " << std::setprecision(3) << std::fixed << snapshot.rate << "/s";
+    os << FormatGauges();
+    os << ", elapsed " << BeautifyDuration(std::chrono::duration<double>(
+                                std::round(snapshot.elapsed)))
+       << ", " << (queue_mode_ ? FormatQueue(snapshot.progress) : FormatRemaining(progress_ratio))
+       << (label_.empty() ? "" : ", " + label_);
+
+    if (logging_mode_) {
+        *out << os.str() << std::endl;
+    } else {
+        // print above the bar, then draw the bar again
+        *out << std::string(display_width(buffer_), ' ') + '\r'
+             << os.str() << '\n' << buffer_ << std::flush;
     }
 }
 
 void ProgressBar::SetFrequencyUpdate(uint64_t frequency_update_) {
     std::lock_guard<std::mutex> lock(mu_);
 
-    if(frequency_update_ > total_){
-        frequency_update = total_;    // prevents crash if freq_updates_ > total_
+    if(Total() && frequency_update_ > Total()){
+        frequency_update = Total();    // prevents crash if freq_updates_ > total_
     } else{
-        frequency_update = frequency_update_;
+        frequency_update = std::max(static_cast<uint64_t>(1), frequency_update_);
     }
 }
 
@@ -87,6 +616,124 @@ void ProgressBar::SetStyle(char unit_bar, char unit_space) {
     unit_space_ = unit_space;
 }
 
+void ProgressBar::SetTotal(uint64_t total) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+
+        assert(total >= progress_.load());
+        total_.store(total);
+        if (!weighted_)
+            frequency_update = std::max(static_cast<uint64_t>(1), total / 1000);
+        if (total > progress_.load())
+            completed_ = false;
+    }
+
+    // a total lowered to the progress completes the bar without increment
+    if (!weighted_ && !silent_ && progress_.load() == total)
+        OnProgress(0, total, total);
+}
+
+void ProgressBar::SetLabel(const std::string &label) {
+    std::lock_guard<std::mutex> lock(mu_);
+
+    label_ = label;
+}
+
+void ProgressBar::SetTotalCost(uint64_t total_cost) {
+    std::lock_guard<std::mutex> lock(mu_);
+
+    weighted_ = true;
+    total_cost_ = total_cost;
+    frequency_update = std::max(static_cast<uint64_t>(1), total_cost_ / 1000);
+}
+
+void ProgressBar::SetByteMode(bool byte_mode) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+
+        byte_mode_ = byte_mode;
+    }
+
+    // the frame drawn by the constructor is redrawn in the new units
+    if (!silent_ && !logging_mode_)
+        ShowProgress(Done());
+}
+
+void ProgressBar::SetRunHistory(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mu_);
+
+    run_history_.reset(new RunHistory(path));
+    has_prior_ = run_history_->Lookup(key_, &prior_);
+    run_.curve[0] = 0;
+    next_curve_point_ = 1;
+}
+
+void ProgressBar::SetSparkline(size_t width) {
+    std::lock_guard<std::mutex> lock(mu_);
+
+    sparkline_width_ = width;
+}
+
+ProgressBar::Gauge ProgressBar::AddGauge(const std::string &name, const std::string &format) {
+    if (!is_gauge_format(format))
+        throw std::runtime_error("AddGauge: \"" + format + "\" is not a format of a single long long");
+
+    std::lock_guard<std::mutex> lock(mu_);
+
+    std::unique_ptr<CacheLineArray<GaugeSlot>> slots(new CacheLineArray<GaugeSlot>(1));
+    GaugeSlot &slot = (*slots)[0];
+    slot.value.store(0);
+    slot.name = name;
+    slot.format = format;
+    gauges_width_ += display_width(name) + 3 + kGaugeWidth;
+    gauges_text_.reserve(gauges_text_.capacity() + name.size() + 3 + kGaugeTextSize);
+    gauges_.push_back(std::move(slots));
+    return Gauge(&slot);
+}
+
+std::vector<double> ProgressBar::GetRateHistory(RateHistory::Resolution resolution) const {
+    std::lock_guard<std::mutex> lock(mu_);
+
+    return rate_history_.Rates(resolution);
+}
+
+ProgressBar::Snapshot ProgressBar::GetSnapshot() const {
+    std::lock_guard<std::mutex> lock(mu_);
+
+    Snapshot snapshot;
+    snapshot.progress = progress_.load(std::memory_order_relaxed);
+    snapshot.total = total_;
+    snapshot.cost = Done();
+    snapshot.total_cost = Total();
+
+    double progress_ratio = snapshot.total_cost
+                          ? static_cast<double>(snapshot.cost) / snapshot.total_cost
+                          : 1.0;
+    std::chrono::duration<double> elapsed = std::chrono::system_clock::now()
+                                          - start_time_.load();
+    snapshot.elapsed = snapshot.cost ? elapsed.count() : 0;
+    snapshot.rate = snapshot.elapsed > 0 ? snapshot.cost / snapshot.elapsed : 0;
+    snapshot.eta = RemainingExecutionTime(progress_ratio).count();
+
+    if (queue_mode_) {
+        // the time to drain the backlog at the net rate, infinite if it grows
+        double arrival, service;
+        QueueRates(&arrival, &service);
+        uint64_t backlog = snapshot.total > snapshot.progress ? snapshot.total - snapshot.progress : 0;
+        snapshot.rate = service;
+        snapshot.eta = !backlog ? 0
+                     : service > arrival ? backlog / (service - arrival)
+                     : std::numeric_limits<double>::infinity();
+        snapshot.eta_p10 = snapshot.eta_p90 = snapshot.eta;
+        return snapshot;
+    }
+
+    double spread = RemainingTimeSpread(snapshot.eta);
+    snapshot.eta_p10 = std::max(0.0, snapshot.eta - std::max(0.0, spread));
+    snapshot.eta_p90 = snapshot.eta + std::max(0.0, spread);
+    return snapshot;
+}
+
 int ProgressBar::GetConsoleWidth() const {
     int width = kDefaultConsoleWidth;
 
@@ -95,8 +742,9 @@ int ProgressBar::GetConsoleWidth() const {
         GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
         width = csbi.srWindow.Right - csbi.srWindow.Left;
 #else
+        // the terminal drawn on, stdin is often a pipe when it is stderr
         struct winsize win;
-        if (ioctl(0, TIOCGWINSZ, &win) != -1)
+        if (ioctl(fd_ >= 0 ? fd_ : 0, TIOCGWINSZ, &win) != -1)
             width = win.ws_col;
 #endif
 
@@ -109,52 +757,61 @@ int ProgressBar::GetBarLength() const {
                     - 9
                     - description_.size()
                     - kCharacterWidthPercentage
-                    - std::floor(std::log10(std::max((uint64_t)2, total_)) + 1) * 2;
-}
-
-std::string get_progress_summary(double progress_ratio) {
-    std::string buffer = std::string(kCharacterWidthPercentage, ' ');
-
-    // in some implementations, snprintf always appends null terminal character
-    snprintf((char *)buffer.data(), kCharacterWidthPercentage,
-             "%5.1f%%", progress_ratio * kTotalPercentage);
-
-    // erase the last null terminal character
-    buffer.pop_back();
-    return buffer;
+                    - (sparkline_width_ ? sparkline_width_ + 1 : 0)
+                    - (label_.empty() ? 0 : display_width(label_) + 2)
+                    - (queue_mode_ ? kQueueWidth : 0)
+                    - gauges_width_
+                    - (byte_mode_ ? kByteCountsWidth
+                                  : std::floor(std::log10(std::max((uint64_t)2, total_.load())) + 1) * 2);
 }
 
 void ProgressBar::ShowProgress(uint64_t progress) const {
-    if (silent_)
+    if (silent_ || detached_.load(std::memory_order_relaxed))
         return;
 
     std::lock_guard<std::mutex> lock(mu_);
 
-    // calculate percentage of progress
-    double progress_ratio = total_ ? static_cast<double>(progress) / total_
-                                   : 1.0;
+    PROGRESS_PROBE3(render_start, Id(), progress, Total());
+    DrawFrame(progress);
+    PROGRESS_PROBE3(render_end, Id(), progress, Total());
+}
+
+void ProgressBar::DrawFrame(uint64_t progress) const {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    rate_history_.Record(now, progress);
+    if (queue_mode_)
+        arrival_history_.Record(now, total_.load());
+
+    // calculate percentage of progress, the arrivals of a queue may lag,
+    // a total of 0 is unknown until the bar completes
+    double progress_ratio = Total() ? std::min(1.0, static_cast<double>(progress) / Total())
+                                    : completed_ || queue_mode_ ? 1.0 : 0.0;
     assert(progress_ratio >= 0.0);
     assert(progress_ratio <= 1.0);
 
+    if (run_history_)
+        RecordCurve(progress_ratio);
+
+    // in weighted mode |progress| is in cost units, but items are displayed
+    uint64_t items = weighted_ ? progress_.load(std::memory_order_relaxed)
+                               : progress;
+    std::string counts = FormatCounts(items) + FormatGauges();
+    std::string remaining = queue_mode_ ? FormatQueue(progress) : FormatRemaining(progress_ratio);
+    std::string suffix = label_.empty() ? "" : ", " + label_;
+
     if (logging_mode_) {
-        // get current time
-        auto now = std::chrono::system_clock::now();
-        std::time_t time = std::chrono::system_clock::to_time_t(now);
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-                                    now.time_since_epoch()) % 1000;
         std::stringstream os;
-        os << std::put_time(std::localtime(&time), "[%F %T.")
-           << std::setfill('0') << std::setw(3) << ms.count() << "]\t"
+        os << get_timestamp() << "\t"
            << get_progress_summary(progress_ratio)
-           << ", " + std::to_string(progress) + "/" + std::to_string(total_)
-           << ", " + BeautifyDuration(RemainingExecutionTime(progress_ratio)) + " remaining" + '\n';
+           << ", " + counts
+           << ", " + remaining + suffix + '\n';
         *out << os.str() << std::flush;
         return;
     }
 
     try {
         // clear previous progressbar
-        *out << std::string(buffer_.size(), ' ') + '\r' << std::flush;
+        *out << std::string(display_width(buffer_), ' ') + '\r' << std::flush;
         buffer_.clear();
 
         // calculate the size of the progress bar
@@ -167,9 +824,11 @@ void ProgressBar::ShowProgress(uint64_t progress) const {
                       + " ["
                         + std::string(size_t(bar_size * progress_ratio), unit_bar_)
                         + std::string(bar_size - size_t(bar_size * progress_ratio), unit_space_)
-                      + "] " + get_progress_summary(progress_ratio)
-                      + ", " + std::to_string(progress) + "/" + std::to_string(total_)
-                      + ", " + BeautifyDuration(RemainingExecutionTime(progress_ratio)) + " remaining" + '\r';
+                      + "] "
+                        + (sparkline_width_ ? rate_history_.Sparkline(sparkline_width_) + ' ' : "")
+                        + get_progress_summary(progress_ratio)
+                      + ", " + counts
+                      + ", " + remaining + suffix + '\r';
 
         *out << buffer_ << std::flush;
 
@@ -191,24 +850,160 @@ ProgressBar& ProgressBar::operator+=(uint64_t delta) {
     if (silent_ || !delta)
         return *this;
 
+    if (weighted_)
+        return Add(delta, delta);
+
     uint64_t after_update
         = progress_.fetch_add(delta, std::memory_order_relaxed) + delta;
 
-    assert(after_update <= total_);
+    // the renderer thread draws queues, whose total keeps moving
+    if (queue_mode_)
+        return *this;
+
+    OnProgress(delta, after_update, total_);
+    return *this;
+}
+
+ProgressBar& ProgressBar::Add(uint64_t items, uint64_t cost) {
+    if (!weighted_)
+        return (*this) += items;
+
+    if (cost_.load() == 0)
+        start_time_.store(std::chrono::system_clock::now());
+
+    if (silent_ || (!items && !cost))
+        return *this;
+
+    // two independent counters: the item count is only displayed, the
+    // cost drives the percentage, the ETA and the update frequency
+    progress_.fetch_add(items, std::memory_order_relaxed);
+    uint64_t after_update
+        = cost_.fetch_add(cost, std::memory_order_relaxed) + cost;
+
+    OnProgress(cost, after_update, total_cost_);
+    return *this;
+}
+
+void ProgressBar::Arrive(uint64_t items) {
+    total_.fetch_add(items, std::memory_order_relaxed);
+}
+
+void ProgressBar::OnProgress(uint64_t delta, uint64_t after_update, uint64_t total) {
+    assert(after_update <= total);
 
     // determines whether to update the progress bar from frequency_update
-    if (after_update == total_
-            || (after_update - delta) / frequency_update
-                        < after_update / frequency_update)
+    // completion may be reached by an increment and SetTotal at once
+    uint64_t frequency = frequency_update.load(std::memory_order_relaxed);
+    bool completes = after_update == total && !completed_.exchange(true);
+    if (completes
+            || (after_update - delta) / frequency < after_update / frequency) {
+        PROGRESS_PROBE3(threshold, Id(), after_update, total);
         ShowProgress(after_update);
+    }
 
-    if (after_update == total_)
-        *out << std::endl;
+    if (completes) {
+        PROGRESS_PROBE2(complete, Id(), total);
+        if (phase_ != PhaseProfiler::kNoPhase)
+            PhaseProfiler::Complete(phase_);
+        if (!detached_)
+            *out << std::endl;
+    }
+}
 
-    return *this;
+uintptr_t ProgressBar::Id() const {
+    return reinterpret_cast<uintptr_t>(this);
+}
+
+uint64_t ProgressBar::Done() const {
+    return weighted_ ? cost_.load() : progress_.load();
+}
+
+uint64_t ProgressBar::Total() const {
+    return weighted_ ? total_cost_ : total_.load();
+}
+
+// "progress/total", in byte mode followed by the recent throughput
+std::string ProgressBar::FormatCounts(uint64_t items) const {
+    if (!byte_mode_) {
+        std::string counts = std::to_string(items);
+        if (total_ || !weighted_)
+            counts += "/" + std::to_string(total_);
+        return counts;
+    }
+
+    RateHistory::Stats stats = rate_history_.WindowStats(kThroughputWindow);
+    double rate = stats.mean;
+    if (!stats.count) {
+        // less than a second of history, use the average since the start
+        std::chrono::duration<double> elapsed = std::chrono::system_clock::now()
+                                              - start_time_.load();
+        rate = items && elapsed.count() > 0 ? items / elapsed.count() : 0;
+    }
+    std::string counts = format_bytes(items);
+    if (total_ || !weighted_)
+        counts += "/" + format_bytes(total_);
+    return counts + ", " + format_bytes(rate) + "/s";
+}
+
+// rates of arrival and completion over the last seconds, averages since
+// the bar was created during the first second
+void ProgressBar::QueueRates(double *arrival, double *service) const {
+    RateHistory::Stats arrivals = arrival_history_.WindowStats(kQueueWindow);
+    RateHistory::Stats completions = rate_history_.WindowStats(kQueueWindow);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                   - created_).count();
+    *arrival = arrivals.count ? arrivals.mean
+                              : elapsed > 0 ? total_.load() / elapsed : 0;
+    *service = completions.count ? completions.mean
+                                 : elapsed > 0 ? progress_.load() / elapsed : 0;
+}
+
+// "backlog N, in X/s, out Y/s", then when the backlog drains at the net
+// rate, or a warning if it does not
+std::string ProgressBar::FormatQueue(uint64_t done) const {
+    uint64_t total = total_.load();
+    uint64_t backlog = total > done ? total - done : 0;
+    double arrival, service;
+    QueueRates(&arrival, &service);
+
+    char buffer[96];
+    snprintf(buffer, sizeof(buffer), "backlog %llu, in %.1f/s, out %.1f/s",
+             static_cast<unsigned long long>(backlog), arrival, service);
+    std::string result = buffer;
+    if (!backlog)
+        return result;
+
+    // rates within a few percent are noise rather than a trend
+    double net = service - arrival;
+    if (std::fabs(net) <= kQueueBalance * std::max(arrival, service))
+        return result + (service > 0 ? ", backlog steady" : ", not draining");
+    if (net > 0) {
+        double drain_s = std::round(backlog / net);
+        return result + ", drains in " + BeautifyDuration(std::chrono::duration<double>(drain_s));
+    }
+    snprintf(buffer, sizeof(buffer), ", backlog growing by %.1f/s", -net);
+    return result + buffer;
+}
+
+// ", name value" for every gauge, into the space reserved by AddGauge
+const std::string &ProgressBar::FormatGauges() const {
+    gauges_text_.clear();
+    char value[kGaugeTextSize];
+    for (const std::unique_ptr<CacheLineArray<GaugeSlot>> &slots : gauges_) {
+        const GaugeSlot &gauge = (*slots)[0];
+        snprintf(value, sizeof(value), gauge.format.c_str(),
+                 static_cast<long long>(gauge.value.load(std::memory_order_relaxed)));
+        gauges_text_ += ", ";
+        gauges_text_ += gauge.name;
+        gauges_text_ += ' ';
+        gauges_text_ += value;
+    }
+    return gauges_text_;
 }
 
 std::chrono::duration<double> ProgressBar::RemainingExecutionTime(double progress_ratio) const {
+    double prior_weight = 1 - progress_ratio;
+
     // epsilon to avoid division by zero
     if (progress_ratio == 0)
         progress_ratio = 1e-2;
@@ -216,7 +1011,54 @@ std::chrono::duration<double> ProgressBar::RemainingExecutionTime(double progres
     auto now = std::chrono::system_clock::now();
     std::chrono::duration<double> diff = now - start_time_.load();
     double total_s = 1 / progress_ratio * diff.count();
-    return std::chrono::duration<double>(total_s - progress_ratio * total_s);
+    double remaining_s = total_s - progress_ratio * total_s;
+
+    // blend the live estimate with the previous run, which dominates at
+    // the start when the live estimate is mostly noise
+    if (has_prior_) {
+        double scale = prior_.total ? static_cast<double>(Total()) / prior_.total
+                                    : 1.0;
+        double prior_s = prior_.duration * scale
+                       * (1 - RunHistory::ElapsedFraction(prior_, 1 - prior_weight));
+        remaining_s = prior_weight * prior_s + (1 - prior_weight) * remaining_s;
+    }
+    return std::chrono::duration<double>(remaining_s);
+}
+
+// stores the elapsed time at every 5% of progress for the run history
+void ProgressBar::RecordCurve(double progress_ratio) const {
+    const size_t kLast = RunHistory::kCurvePoints - 1;
+    if (next_curve_point_ > kLast || progress_ratio * kLast < next_curve_point_)
+        return;
+
+    std::chrono::duration<double> elapsed = std::chrono::system_clock::now()
+                                          - start_time_.load();
+    while (next_curve_point_ <= kLast && progress_ratio * kLast >= next_curve_point_)
+        run_.curve[next_curve_point_++] = elapsed.count();
+}
+
+// Half-width of the 80% interval of the remaining time, or a negative value
+// if there are not enough samples. Over T seconds the amount of work done
+// has a standard deviation of sigma * sqrt(T), which at the mean rate mu
+// translates into sigma * sqrt(T) / mu seconds.
+double ProgressBar::RemainingTimeSpread(double remaining_s) const {
+    RateHistory::Stats stats = rate_history_.WindowStats(kRateWindow);
+    if (stats.count < kMinRateSamples || stats.mean <= 0)
+        return -1;
+
+    return kZ90 * std::sqrt(stats.variance * remaining_s) / stats.mean;
+}
+
+std::string ProgressBar::FormatRemaining(double progress_ratio) const {
+    std::chrono::duration<double> remaining = RemainingExecutionTime(progress_ratio);
+    std::string result = BeautifyDuration(remaining);
+
+    // sub-second spreads are not worth the columns
+    double spread = std::round(RemainingTimeSpread(remaining.count()));
+    if (spread >= 1 && progress_ratio < 1.0)
+        result += " \xc2\xb1" + BeautifyDuration(std::chrono::duration<double>(spread));
+
+    return result + " remaining";
 }
 
 // from https://stackoverflow.com/questions/22590821/convert-stdduration-to-human-readable-time
@@ -5,52 +5,277 @@
 #include <windows.h>
 #else
 #include <sys/ioctl.h>
+#include <signal.h>
 #endif
 
 #include <iostream>
 #include <string>
+#include <vector>
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <condition_variable>
+
+#include "cache_line.hpp"
+#include "rate_history.hpp"
+#include "run_history.hpp"
+#include "phase_profiler.hpp"
 
 
 class ProgressBar {
   public:
+#ifndef _WINDOWS
+    static const int kStatusSignal = SIGUSR1;
+#else
+    static const int kStatusSignal = 0;
+#endif
+
+    struct Snapshot {
+        uint64_t progress;
+        uint64_t total;
+        uint64_t cost;        // equal to progress unless weighted
+        uint64_t total_cost;  // equal to total unless weighted
+        double elapsed;    // seconds since the first increment
+        double rate;       // cost units per second
+        double eta;        // seconds remaining, point estimate
+        double eta_p10;    // 80% interval of the seconds remaining,
+        double eta_p90;    // equal to eta until enough rate samples exist
+    };
+
+  private:
+    // the value alone in its cache line, the rest only read when drawing
+    struct alignas(kCacheLineSize) GaugeSlot {
+        std::atomic<int64_t> value;
+        char padding[kCacheLineSize - sizeof(std::atomic<int64_t>)];
+        std::string name;
+        std::string format;
+    };
+
+  public:
+    // A live value shown in the bar line, such as a queue depth or a
+    // number of requests in flight. Set and Add are relaxed atomic
+    // operations on a cache line of its own: they never lock nor
+    // allocate, the value is only read when a frame is drawn.
+    class Gauge {
+      public:
+        void Set(int64_t value) {
+            slot_->value.store(value, std::memory_order_relaxed);
+        }
+        void Add(int64_t delta) {
+            slot_->value.fetch_add(delta, std::memory_order_relaxed);
+        }
+        int64_t Get() const {
+            return slot_->value.load(std::memory_order_relaxed);
+        }
+
+      private:
+        friend class ProgressBar;
+        explicit Gauge(GaugeSlot *slot) : slot_(slot) {}
+
+        GaugeSlot *slot_;
+    };
+
+    // a total of 0 is unknown, e.g. discovered while progressing: the bar
+    // is completed once SetTotal gives one, or empty when destroyed
     ProgressBar(uint64_t total,
                 const std::string &description = "",
                 std::ostream &out = std::cerr,
                 bool silent = false);
 
+    // Observe mode: the progress is not incremented but read from a value
+    // the loop already maintains, sampled every kObserveInterval by a
+    // renderer thread, so that the loop itself does no extra work. The
+    // value must only grow, and outlive the bar, which takes a last
+    // sample when destroyed.
+    typedef std::function<uint64_t()> Source;
+    ProgressBar(uint64_t total,
+                const std::atomic<uint64_t> &counter,
+                const std::string &description = "",
+                std::ostream &out = std::cerr);
+    // read with relaxed atomic loads, like std::atomic_ref; the value is
+    // seen when the loop stores it to memory, a loop index the compiler
+    // keeps in a register is only seen when the bar is destroyed
+    ProgressBar(uint64_t total,
+                uint64_t &counter,
+                const std::string &description = "",
+                std::ostream &out = std::cerr);
+    // called from the renderer thread only
+    ProgressBar(uint64_t total,
+                Source source,
+                const std::string &description = "",
+                std::ostream &out = std::cerr);
+    // a temporary, e.g. converted from an int, would be observed dangling
+    ProgressBar(uint64_t total, std::atomic<uint64_t> &&counter,
+                const std::string &description = "",
+                std::ostream &out = std::cerr) = delete;
+
+    // Queue-drain mode, for consumers of a work queue: the total is the
+    // number of items enqueued, reported by producers with Arrive, and
+    // the progress the number completed, both lock-free counters. Instead
+    // of an ETA, a renderer thread draws the backlog, the arrival and
+    // service rates, and the time to drain the backlog at the net rate,
+    // or a warning when the backlog grows.
+    enum QueueTag { kQueue };
+    ProgressBar(QueueTag,
+                const std::string &description = "",
+                std::ostream &out = std::cerr);
+
     ~ProgressBar();
 
     void SetFrequencyUpdate(uint64_t frequency_update_);
     void SetStyle(char unit_bar, char unit_space);
+    // changes the total when it is only discovered while progressing,
+    // it must not go below the current progress, and completes the bar if
+    // equal to it; like the constructor, sets the update frequency to
+    // 1/1000 of the total
+    void SetTotal(uint64_t total);
+    // free text shown at the end of the bar line
+    void SetLabel(const std::string &label);
+    // shows a sparkline of the last |width| seconds of rate, 0 disables it
+    void SetSparkline(size_t width);
+    // adds a gauge shown as "|name| value" after the counts, the value
+    // formatted by |format|, a printf format with a single conversion of
+    // a long long such as "%lld" or "%5lld%%"; during setup, throws
+    // std::runtime_error if the format is not one
+    Gauge AddGauge(const std::string &name, const std::string &format = "%lld");
+    // switches to weighted mode, where percentage, rate and ETA are
+    // computed from the cost of the items instead of their count
+    void SetTotalCost(uint64_t total_cost);
+    // displays progress and total as byte sizes, followed by the
+    // throughput over the last seconds
+    void SetByteMode(bool byte_mode = true);
+    // uses the run recorded in |path| under the same description as a
+    // prior for the ETA, and records this run there once it completes
+    void SetRunHistory(const std::string &path);
+
+    // rates in units per second at the given resolution, oldest first
+    std::vector<double> GetRateHistory(RateHistory::Resolution resolution) const;
+
+    Snapshot GetSnapshot() const;
+
+    // On SIGINT and SIGTERM, writes the state of every live bar with
+    // async-signal-safe calls only, then chains to the previous handler.
+    // Bars drawing to other streams than std::cout, std::cerr and
+    // std::clog are skipped. A bar destroyed on another thread meanwhile
+    // waits for the handler before it is freed. No-op on Windows.
+    static void InstallSignalHandlers();
+
+    // On |signum|, a watcher thread writes a full status line for every
+    // live bar: progress, rate, elapsed time, ETA and label. The signal
+    // handler only sets a flag, so nothing is added to the increment
+    // path. No-op on Windows.
+    static void EnableStatusDump(int signum = kStatusSignal);
+    // writes the status line of every live bar now
+    static void DumpStatus();
 
     ProgressBar& operator++();
     ProgressBar& operator+=(uint64_t delta);
+    // adds |items| costing |cost| units in total, in weighted mode
+    // operator+= counts each item with a cost of one unit
+    ProgressBar& Add(uint64_t items, uint64_t cost);
+    // |items| were enqueued, in queue-drain mode; before they are, so
+    // that completions never exceed arrivals
+    void Arrive(uint64_t items = 1);
 
   private:
     ProgressBar(const ProgressBar &) = delete;
     ProgressBar& operator=(const ProgressBar &) = delete;
+    ProgressBar(uint64_t total,
+                const std::string &description,
+                std::ostream &out,
+                bool silent,
+                bool queue_mode);
 
     void ShowProgress(uint64_t progress) const;
+    void DrawFrame(uint64_t progress) const;
+    uintptr_t Id() const;
+    void OnProgress(uint64_t delta, uint64_t after_update, uint64_t total);
+    uint64_t Done() const;
+    uint64_t Total() const;
     int GetConsoleWidth() const;
     int GetBarLength() const;
     std::chrono::duration<double> RemainingExecutionTime(double progress_ratio) const;
+    double RemainingTimeSpread(double remaining_s) const;
+    std::string FormatCounts(uint64_t items) const;
+    std::string FormatRemaining(double progress_ratio) const;
     std::string BeautifyDuration(std::chrono::duration<double> input_seconds) const;
+    void RecordCurve(double progress_ratio) const;
+
+    // registry of the live bars, used by the fork handlers
+    void Register();
+    void Unregister();
+    static void PrepareFork();
+    static void AfterForkInParent();
+    static void AfterForkInChild();
+#ifndef _WINDOWS
+    static void OnTerminationSignal(int signum, siginfo_t *info, void *context);
+    void WriteFinalFrame() const;
+#endif
+    void WriteStatus() const;
+    void Observe(Source source);
+    void StartRenderer();
+    void Sample();
+    void StopObserver();
+    void QueueRates(double *arrival, double *service) const;
+    std::string FormatQueue(uint64_t done) const;
+    const std::string &FormatGauges() const;
 
     bool silent_;
     bool logging_mode_;
-    uint64_t total_;
+    bool queue_mode_;
+    std::atomic<uint64_t> total_;
     std::atomic<uint64_t> progress_ = {0};
-    uint64_t frequency_update;
+    bool weighted_ = false;
+    uint64_t total_cost_ = 0;
+    std::atomic<uint64_t> cost_ = {0};
+    // atomic since the total can change while other threads increment
+    std::atomic<uint64_t> frequency_update = {1};
     std::ostream *out;
+    int fd_ = -1;    // file descriptor behind |out|, if known
     std::atomic<std::chrono::time_point<std::chrono::system_clock>> start_time_;
     mutable std::mutex mu_;
+    std::atomic<ProgressBar *> *registry_slot_ = nullptr;
+    size_t phase_ = PhaseProfiler::kNoPhase;
+    // the final frame was drawn, cleared when the total is raised again
+    std::atomic<bool> completed_ = {false};
+    // set in forked children, which keep counting but never draw
+    std::atomic<bool> detached_ = {false};
     mutable std::string buffer_;
+    mutable RateHistory rate_history_;
+    size_t sparkline_width_ = 0;
+    bool byte_mode_ = false;
+    std::unique_ptr<RunHistory> run_history_;
+    bool has_prior_ = false;
+    RunHistory::Run prior_;
+    mutable RunHistory::Run run_;
+    mutable size_t next_curve_point_ = 1;
+
+    // a single slot each, never moved since gauges point to them
+    std::vector<std::unique_ptr<CacheLineArray<GaugeSlot>>> gauges_;
+    // reserved by AddGauge, so that drawing the gauges never allocates
+    mutable std::string gauges_text_;
+    size_t gauges_width_ = 0;
 
     std::string description_;
+    std::string key_;
+    std::string label_;
     char unit_bar_ = '=';
     char unit_space_ = ' ';
+
+    // queue-drain mode, the total counts the arrivals
+    std::chrono::steady_clock::time_point created_;
+    mutable RateHistory arrival_history_;
+
+    // renderer thread of observe and queue-drain modes, forgotten in
+    // forked children
+    Source source_;
+    std::thread observer_;
+    std::mutex observer_mu_;
+    std::condition_variable observer_cv_;
+    bool observer_stop_ = false;
 };
 
 #endif // _PROGRESS_BAR_
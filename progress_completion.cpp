@@ -0,0 +1,185 @@
+#include "progress_completion.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace progress {
+
+// a freed page, never dereferenced
+CompletionTracker::Page *const CompletionTracker::kFull
+    = reinterpret_cast<CompletionTracker::Page *>(1);
+
+static int lowest_bit(uint64_t bits) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int n = 0;
+    for (; !(bits & 1); bits >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+CompletionTracker::CompletionTracker(ProgressBar &bar)
+      : bar_(bar), total_(bar.GetSnapshot().total) {
+    label_step_ = std::max(static_cast<uint64_t>(1), total_ / 1000);
+    uint64_t pages = (total_ + kPageItems - 1) / kPageItems;
+    slots_.reset(new Slot[pages]);
+    for (uint64_t i = 0; i < pages; ++i) {
+        slots_[i].page.store(nullptr);
+        slots_[i].pins.store(0);
+    }
+}
+
+CompletionTracker::~CompletionTracker() {
+    uint64_t pages = (total_ + kPageItems - 1) / kPageItems;
+    for (uint64_t i = freed_.load(); i < pages; ++i) {
+        Page *page = slots_[i].page.load();
+        if (page != kFull)
+            delete page;
+    }
+}
+
+// Marks are sequentially consistent: a thread setting the bit at the
+// watermark either sees the watermark reach it and advances it, or its
+// bit is seen by the thread advancing the watermark there.
+bool CompletionTracker::Mark(uint64_t index) {
+    if (index >= total_)
+        throw std::runtime_error("CompletionTracker: index " + std::to_string(index)
+                                 + " is out of range");
+    if (index < watermark_.load())
+        return false;
+
+    uint64_t page_index = index / kPageItems;
+    Page *page = Pin(page_index);
+    if (!page) {
+        Page *fresh = new Page();
+        if (slots_[page_index].page.compare_exchange_strong(page, fresh)) {
+            page = fresh;
+            ++pages_;
+        } else {
+            delete fresh;
+        }
+    }
+    // a duplicate mark races with the thread that marked |index|, which
+    // may have moved the watermark past the page and freed it meanwhile
+    if (page == kFull) {
+        Unpin(page_index);
+        return false;
+    }
+    uint64_t bit = 1ULL << (index % 64);
+    bool fresh = !(page->words[index % kPageItems / 64].fetch_or(bit) & bit);
+    Unpin(page_index);
+    if (!fresh)
+        return false;
+
+    completed_.fetch_add(1, std::memory_order_relaxed);
+    if (index == watermark_.load())
+        Advance();
+    bar_ += 1;
+    return true;
+}
+
+bool CompletionTracker::IsDone(uint64_t index) const {
+    if (index >= total_)
+        return false;
+    if (index < watermark_.load())
+        return true;
+
+    uint64_t page_index = index / kPageItems;
+    Page *page = Pin(page_index);
+    bool done = page == kFull
+             || (page && (page->words[index % kPageItems / 64].load() >> (index % 64) & 1));
+    Unpin(page_index);
+    return done;
+}
+
+uint64_t CompletionTracker::Completed() const {
+    return completed_.load(std::memory_order_relaxed);
+}
+
+uint64_t CompletionTracker::Watermark() const {
+    return watermark_.load();
+}
+
+uint64_t CompletionTracker::Pages() const {
+    return pages_.load(std::memory_order_relaxed);
+}
+
+CompletionTracker::Page *CompletionTracker::Pin(uint64_t page) const {
+    slots_[page].pins.fetch_add(1);
+    return slots_[page].page.load();
+}
+
+void CompletionTracker::Unpin(uint64_t page) const {
+    slots_[page].pins.fetch_sub(1);
+}
+
+// the first index at or after |from| not marked, |from| itself if its
+// page was freed meanwhile, i.e. the watermark already moved past it
+uint64_t CompletionTracker::FirstUnmarked(uint64_t from) const {
+    while (from < total_) {
+        uint64_t page_index = from / kPageItems;
+        Page *page = Pin(page_index);
+        if (!page || page == kFull) {
+            Unpin(page_index);
+            return from;
+        }
+        uint64_t offset = from % kPageItems;
+        for (uint64_t word = offset / 64; word < kPageWords; ++word) {
+            uint64_t unmarked = ~page->words[word].load();
+            if (word == offset / 64)
+                unmarked &= ~0ULL << (offset % 64);
+            if (unmarked) {
+                Unpin(page_index);
+                return std::min(total_, page_index * kPageItems + word * 64
+                                        + lowest_bit(unmarked));
+            }
+        }
+        Unpin(page_index);
+        from = (page_index + 1) * kPageItems;
+    }
+    return total_;
+}
+
+// Moves the watermark over the marked prefix. The thread whose exchange
+// succeeds scans again, so that a bit set while it scanned is not missed,
+// then labels the bar and frees the pages left behind.
+void CompletionTracker::Advance() {
+    uint64_t watermark = watermark_.load();
+    for (;;) {
+        uint64_t next = FirstUnmarked(watermark);
+        if (next <= watermark)
+            return;
+        if (!watermark_.compare_exchange_strong(watermark, next))
+            continue;
+
+        if (next / label_step_ != watermark / label_step_ || next == total_)
+            bar_.SetLabel("contiguous " + std::to_string(next));
+        Free(next == total_ ? (total_ + kPageItems - 1) / kPageItems
+                            : next / kPageItems);
+        watermark = next;
+    }
+}
+
+// frees the pages below |below|, waiting for the threads still using them
+void CompletionTracker::Free(uint64_t below) {
+    uint64_t page_index = freed_.load();
+    while (page_index < below) {
+        if (!freed_.compare_exchange_weak(page_index, page_index + 1))
+            continue;
+
+        Page *page = slots_[page_index].page.exchange(kFull);
+        while (slots_[page_index].pins.load())
+            std::this_thread::yield();
+        if (page && page != kFull) {
+            delete page;
+            --pages_;
+        }
+        ++page_index;
+    }
+}
+
+} // namespace progress
@@ -0,0 +1,93 @@
+#ifndef _PROGRESS_COMPLETION_
+#define _PROGRESS_COMPLETION_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "progress_bar.hpp"
+
+
+// Completion of items finished out of order, for checkpointing.
+//
+// Workers mark the indexes of the items they finish in a bitmap. An item
+// marked twice is counted once, and the watermark, the lowest unfinished
+// index, advances without locks as the prefix of the range fills up: a
+// checkpoint taken at the watermark never skips an unfinished item.
+//
+// The bitmap is made of pages of kPageItems items allocated on the first
+// mark and freed once the watermark passes them, so that memory follows
+// the window of items in flight rather than the whole range.
+//
+//     ProgressBar bar(items, "process");
+//     progress::CompletionTracker tracker(bar);
+//     // from any thread
+//     process(item);
+//     tracker.Mark(item);
+//     // from the checkpointing thread
+//     save_checkpoint(tracker.Watermark());
+//
+namespace progress {
+
+class CompletionTracker {
+  public:
+    static const uint64_t kPageItems = 64 * 1024;
+
+    // tracks the indexes [0, total) with total that of |bar|, which is
+    // incremented once per item and labeled with the watermark
+    explicit CompletionTracker(ProgressBar &bar);
+
+    ~CompletionTracker();
+
+    // marks |index| done, from any thread, and returns false if it already
+    // was; throws std::runtime_error if |index| is out of range
+    bool Mark(uint64_t index);
+
+    bool IsDone(uint64_t index) const;
+    // the number of distinct items marked
+    uint64_t Completed() const;
+    // the lowest index not marked yet, the total once all are
+    uint64_t Watermark() const;
+    // the number of pages currently allocated
+    uint64_t Pages() const;
+
+  private:
+    CompletionTracker(const CompletionTracker &) = delete;
+    CompletionTracker& operator=(const CompletionTracker &) = delete;
+
+    static const uint64_t kPageWords = kPageItems / 64;
+
+    struct Page {
+        std::atomic<uint64_t> words[kPageWords];
+    };
+
+    // |pins| counts the threads using the page, which is only freed once
+    // it is swapped for kFull and no thread uses it anymore
+    struct Slot {
+        std::atomic<Page *> page;
+        std::atomic<uint32_t> pins;
+    };
+
+    static Page *const kFull;
+
+    Page *Pin(uint64_t page) const;
+    void Unpin(uint64_t page) const;
+    uint64_t FirstUnmarked(uint64_t from) const;
+    void Advance();
+    void Free(uint64_t below);
+
+    ProgressBar &bar_;
+    uint64_t total_;
+    // the watermark is shown every |label_step_| items
+    uint64_t label_step_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> completed_ = {0};
+    std::atomic<uint64_t> watermark_ = {0};
+    // pages below are freed or being freed
+    std::atomic<uint64_t> freed_ = {0};
+    std::atomic<uint64_t> pages_ = {0};
+};
+
+} // namespace progress
+
+#endif // _PROGRESS_COMPLETION_
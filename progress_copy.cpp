@@ -0,0 +1,398 @@
+#include "progress_copy.hpp"
+#include "progress_algorithms.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace progress {
+
+// small enough to stay in the L2 cache, larger ones were measured slower
+const size_t kPipeSize = 256 << 10;
+const size_t kBufferSize = 128 << 10;
+const size_t kMinChunkSize = 1 << 16;
+
+
+static std::runtime_error copy_error(const std::string &message) {
+    return std::runtime_error("copy_file: " + message + ": " + strerror(errno));
+}
+
+static std::runtime_error stream_error(const std::string &message) {
+    return std::runtime_error("copy_stream: " + message + ": " + strerror(errno));
+}
+
+// errors meaning that a method does not apply to these files
+static bool is_unsupported(int error) {
+    return error == ENOSYS || error == EXDEV || error == EINVAL
+        || error == EOPNOTSUPP || error == ENOTSUP || error == EBADF;
+}
+
+namespace {
+
+// closes the descriptor on every exit path
+struct FileDescriptor {
+    int fd;
+
+    explicit FileDescriptor(int fd_) : fd(fd_) {}
+    ~FileDescriptor() {
+        if (fd >= 0)
+            close(fd);
+    }
+};
+
+// Copies chunks with one method. Holds what the method needs on each
+// thread: sendfile writes at the file position, so it gets its own output
+// descriptor, splice a pipe and read/write a buffer.
+class ChunkCopier {
+  public:
+    ChunkCopier(CopyOptions::Method method, int in, int out, const std::string &to)
+          : method_(method), in_(in), out_(out) {
+        if (method_ == CopyOptions::kSendfile) {
+            own_out_ = open(to.c_str(), O_WRONLY | O_CLOEXEC);
+            if (own_out_ < 0)
+                throw copy_error("cannot open " + to);
+            out_ = own_out_;
+        } else if (method_ == CopyOptions::kSplice) {
+            if (pipe2(pipe_, O_CLOEXEC))
+                throw copy_error("cannot create a pipe");
+            fcntl(pipe_[1], F_SETPIPE_SZ, kPipeSize);
+            int size = fcntl(pipe_[1], F_GETPIPE_SZ);
+            pipe_size_ = size > 0 ? size : 1 << 16;
+        } else if (method_ == CopyOptions::kReadWrite) {
+            buffer_.resize(kBufferSize);
+        }
+    }
+
+    ~ChunkCopier() {
+        if (own_out_ >= 0)
+            close(own_out_);
+        if (pipe_[0] >= 0) {
+            close(pipe_[0]);
+            close(pipe_[1]);
+        }
+    }
+
+    // copies at most |length| bytes at |offset|, returns the bytes copied,
+    // 0 at the end of the source or -1 with errno set
+    ssize_t Copy(uint64_t offset, size_t length) {
+        switch (method_) {
+        case CopyOptions::kCopyFileRange: {
+#ifdef SYS_copy_file_range
+            loff_t in_offset = offset, out_offset = offset;
+            return syscall(SYS_copy_file_range, in_, &in_offset, out_, &out_offset,
+                           length, 0);
+#else
+            errno = ENOSYS;
+            return -1;
+#endif
+        }
+        case CopyOptions::kSendfile: {
+            if (position_ != offset && lseek(out_, offset, SEEK_SET) < 0)
+                return -1;
+            off_t in_offset = offset;
+            ssize_t n = sendfile(out_, in_, &in_offset, length);
+            position_ = n > 0 ? offset + n : static_cast<uint64_t>(-1);
+            return n;
+        }
+        case CopyOptions::kSplice: {
+            loff_t in_offset = offset;
+            ssize_t n = splice(in_, &in_offset, pipe_[1], nullptr,
+                               std::min(length, pipe_size_), SPLICE_F_MOVE);
+            // the pipe is drained before returning, whatever happens
+            loff_t out_offset = offset;
+            for (ssize_t left = n; left > 0;) {
+                ssize_t m = splice(pipe_[0], nullptr, out_, &out_offset, left, SPLICE_F_MOVE);
+                if (m < 0 && errno != EINTR)
+                    return -1;
+                left -= std::max<ssize_t>(m, 0);
+            }
+            return n;
+        }
+        case CopyOptions::kReadWrite: {
+            ssize_t n = pread(in_, &buffer_[0], std::min(length, buffer_.size()), offset);
+            for (ssize_t written = 0; written < n;) {
+                ssize_t m = pwrite(out_, &buffer_[written], n - written, offset + written);
+                if (m < 0 && errno != EINTR)
+                    return -1;
+                written += std::max<ssize_t>(m, 0);
+            }
+            return n;
+        }
+        default:
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+  private:
+    ChunkCopier(const ChunkCopier &) = delete;
+    ChunkCopier& operator=(const ChunkCopier &) = delete;
+
+    CopyOptions::Method method_;
+    int in_;
+    int out_;
+    int own_out_ = -1;
+    int pipe_[2] = {-1, -1};
+    size_t pipe_size_ = 0;
+    uint64_t position_ = 0;   // of own_out_, -1 when unknown
+    std::vector<char> buffer_;
+};
+
+} // namespace
+
+const char *copy_method_name(CopyOptions::Method method) {
+    switch (method) {
+    case CopyOptions::kAuto:          return "auto";
+    case CopyOptions::kCopyFileRange: return "copy_file_range";
+    case CopyOptions::kSendfile:      return "sendfile";
+    case CopyOptions::kSplice:        return "splice";
+    case CopyOptions::kReadWrite:     return "read/write";
+    }
+    return "unknown";
+}
+
+CopyResult copy_file(const std::string &from, const std::string &to,
+                     ProgressBar *bar, const CopyOptions &options) {
+    FileDescriptor in(open(from.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat in_stat;
+    if (in.fd < 0 || fstat(in.fd, &in_stat))
+        throw copy_error("cannot open " + from);
+    if (!S_ISREG(in_stat.st_mode)) {
+        errno = EINVAL;
+        throw copy_error(from + " is not a regular file");
+    }
+
+    // not truncated before checking that it is not the source
+    FileDescriptor out(open(to.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC,
+                            in_stat.st_mode & 07777));
+    struct stat out_stat;
+    if (out.fd < 0 || fstat(out.fd, &out_stat))
+        throw copy_error("cannot create " + to);
+    if (in_stat.st_dev == out_stat.st_dev && in_stat.st_ino == out_stat.st_ino) {
+        errno = EINVAL;
+        throw copy_error(from + " and " + to + " are the same file");
+    }
+
+    // chunks written past the end leave holes that earlier chunks fill,
+    // sizing the file up front was measured slower on ext4
+    const uint64_t size = in_stat.st_size;
+    if (ftruncate(out.fd, 0))
+        throw copy_error("cannot truncate " + to);
+    posix_fadvise(in.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // files of /proc and /sys report a size of 0 and are read to their end,
+    // without progress since there is no total
+    if (!size) {
+        ChunkCopier copier(CopyOptions::kReadWrite, in.fd, out.fd, to);
+        CopyResult result = {0, CopyOptions::kReadWrite};
+        for (ssize_t n = 1; n;) {
+            n = copier.Copy(result.bytes, kBufferSize);
+            if (n < 0 && errno != EINTR)
+                throw copy_error("cannot copy " + from + " to " + to);
+            result.bytes += std::max<ssize_t>(n, 0);
+        }
+        return result;
+    }
+
+    const size_t chunk_size = std::max(options.chunk_size, kMinChunkSize);
+    std::vector<CopyOptions::Method> methods;
+    if (options.method == CopyOptions::kAuto)
+        methods = {CopyOptions::kCopyFileRange, CopyOptions::kSendfile,
+                   CopyOptions::kSplice, CopyOptions::kReadWrite};
+    else
+        methods = {options.method};
+
+    // the first chunk picks the method, a method copying nothing from a
+    // non-empty file is not trusted either
+    CopyResult result = {0, methods[0]};
+    for (size_t i = 0; i < methods.size(); ++i) {
+        ChunkCopier copier(methods[i], in.fd, out.fd, to);
+        ssize_t n;
+        do {
+            n = copier.Copy(0, std::min<uint64_t>(size, chunk_size));
+        } while (n < 0 && errno == EINTR);
+
+        if (n > 0) {
+            result.bytes = n;
+            result.method = methods[i];
+            break;
+        }
+        if (n < 0 && !is_unsupported(errno))
+            throw copy_error("cannot copy " + from + " to " + to);
+        if (i + 1 == methods.size()) {
+            if (!n)
+                errno = EIO;
+            throw copy_error("cannot copy " + from + " to " + to);
+        }
+    }
+    if (bar && result.bytes)
+        *bar += result.bytes;
+
+    // the rest is split in chunks claimed by the threads
+    const uint64_t first = result.bytes;
+    const size_t chunks = (size - first + chunk_size - 1) / chunk_size;
+    unsigned threads = size >= options.parallel_size ? options.threads : 1;
+    threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, chunks)));
+
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> copied(first);
+    std::atomic<bool> failed(false);
+    std::vector<std::exception_ptr> errors(threads);
+    run_on_threads(threads, [&](unsigned t) {
+        try {
+            ChunkCopier copier(result.method, in.fd, out.fd, to);
+            for (size_t c = next++; c < chunks && !failed; c = next++) {
+                uint64_t offset = first + c * chunk_size;
+                uint64_t end = std::min<uint64_t>(size, offset + chunk_size);
+                while (offset < end) {
+                    ssize_t n = copier.Copy(offset, end - offset);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n < 0)
+                        throw copy_error("cannot copy " + from + " to " + to);
+                    if (n == 0)
+                        break;
+                    offset += n;
+                    copied += n;
+                    if (bar)
+                        *bar += n;
+                }
+            }
+        } catch (...) {
+            errors[t] = std::current_exception();
+            failed = true;
+        }
+    });
+    for (const std::exception_ptr &error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    result.bytes = copied;
+    if (result.bytes != size) {
+        errno = EIO;
+        throw copy_error(from + " was truncated during the copy");
+    }
+    return result;
+}
+
+static bool is_pipe(int fd) {
+    struct stat st;
+    return !fstat(fd, &st) && S_ISFIFO(st.st_mode);
+}
+
+// returns false with errno set if not everything could be written
+static bool write_all(int fd, const char *data, size_t size) {
+    while (size) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+CopyResult copy_stream(int in, int out, ProgressBar *bar, CopyOptions::Method method) {
+    if (method != CopyOptions::kAuto && method != CopyOptions::kSplice
+            && method != CopyOptions::kReadWrite) {
+        errno = EINVAL;
+        throw stream_error(std::string(copy_method_name(method)) + " cannot copy streams");
+    }
+
+    CopyResult result = {0, method == CopyOptions::kReadWrite ? CopyOptions::kReadWrite
+                                                              : CopyOptions::kSplice};
+    // splice needs a pipe on one side, the data goes through one otherwise
+    const bool direct = is_pipe(in) || is_pipe(out);
+    for (int fd : {in, out})
+        if (is_pipe(fd))
+            fcntl(fd, F_SETPIPE_SZ, kPipeSize);
+    int through[2] = {-1, -1};
+    if (result.method == CopyOptions::kSplice && !direct) {
+        if (pipe2(through, O_CLOEXEC))
+            throw stream_error("cannot create a pipe");
+        fcntl(through[1], F_SETPIPE_SZ, kPipeSize);
+    }
+    FileDescriptor through_out(through[0]), through_in(through[1]);
+    std::vector<char> buffer(result.method == CopyOptions::kReadWrite ? kBufferSize : 0);
+
+    // the total is raised to stay above the progress of longer streams
+    uint64_t done = 0, total = 0;
+    if (bar) {
+        ProgressBar::Snapshot snapshot = bar->GetSnapshot();
+        done = snapshot.progress;
+        total = snapshot.total;
+    }
+
+    for (;;) {
+        ssize_t n;
+        if (result.method == CopyOptions::kSplice) {
+            n = splice(in, nullptr, direct ? out : through[1], nullptr, kPipeSize,
+                       SPLICE_F_MOVE | SPLICE_F_MORE);
+            // the pipe is drained before going on, through the buffer
+            // from the first write that splice does not support
+            for (ssize_t left = direct ? 0 : n; left > 0;) {
+                ssize_t m;
+                if (result.method == CopyOptions::kSplice) {
+                    m = splice(through[0], nullptr, out, nullptr, left, SPLICE_F_MOVE);
+                    if (m < 0 && is_unsupported(errno) && method == CopyOptions::kAuto) {
+                        result.method = CopyOptions::kReadWrite;
+                        buffer.resize(kBufferSize);
+                        continue;
+                    }
+                } else {
+                    m = read(through[0], &buffer[0], std::min<size_t>(left, buffer.size()));
+                    if (m > 0 && !write_all(out, &buffer[0], m))
+                        m = -1;
+                }
+                if (m < 0 && errno == EINTR)
+                    continue;
+                if (m < 0)
+                    throw stream_error("cannot write the output");
+                left -= m;
+            }
+        } else {
+            n = read(in, &buffer[0], buffer.size());
+            if (n > 0 && !write_all(out, &buffer[0], n))
+                throw stream_error("cannot write the output");
+        }
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        // nothing was moved, the fallback starts from the same point
+        if (n < 0 && result.method == CopyOptions::kSplice && method == CopyOptions::kAuto
+                && is_unsupported(errno)) {
+            result.method = CopyOptions::kReadWrite;
+            buffer.resize(kBufferSize);
+            continue;
+        }
+        if (n < 0)
+            throw stream_error("cannot copy the stream");
+        if (n == 0)
+            break;
+        result.bytes += n;
+        if (bar) {
+            if (done + n > total)
+                bar->SetTotal(total = done + n + 1);
+            *bar += n;
+            done += n;
+        }
+    }
+
+    if (bar && total != done)
+        bar->SetTotal(done);
+    return result;
+}
+
+} // namespace progress
@@ -0,0 +1,65 @@
+#ifndef _PROGRESS_COPY_
+#define _PROGRESS_COPY_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "progress_bar.hpp"
+
+
+// File copy reporting copied bytes to a ProgressBar, Linux only.
+//
+// The data is moved by the kernel whenever possible: copy_file_range,
+// which may also reflink or copy server-side, then sendfile, then splice
+// through a pipe, and as a last resort pread/pwrite. The first method
+// that works on the first chunk is used for the whole file. Large files
+// can be copied as chunks claimed by several threads.
+//
+//     ProgressBar bar(size, "copy");
+//     bar.SetByteMode();
+//     progress::copy_file("data.bin", "/mnt/backup/data.bin", &bar);
+//
+namespace progress {
+
+struct CopyOptions {
+    enum Method { kAuto, kCopyFileRange, kSendfile, kSplice, kReadWrite };
+
+    // kAuto tries the methods above in order
+    Method method = kAuto;
+    // files of at least |parallel_size| bytes are copied by |threads| threads
+    unsigned threads = 1;
+    uint64_t parallel_size = 256 << 20;
+    // bytes per chunk, the bar is moved once per chunk
+    size_t chunk_size = 16 << 20;
+};
+
+struct CopyResult {
+    uint64_t bytes;
+    CopyOptions::Method method;
+};
+
+const char *copy_method_name(CopyOptions::Method method);
+
+// Copies the regular file |from| to |to|, which is created or truncated
+// with the permissions of |from|, and adds the copied bytes to |bar| if
+// not null. Throws std::runtime_error on failure.
+CopyResult copy_file(const std::string &from, const std::string &to,
+                     ProgressBar *bar = nullptr,
+                     const CopyOptions &options = CopyOptions());
+
+// Copies |in| to |out| until the end of |in|, e.g. from stdin to stdout
+// in a pipeline, and adds the copied bytes to |bar| if not null. Only
+// kAuto, kSplice and kReadWrite apply: splice moves the data directly if
+// either end is a pipe and through a pipe otherwise, and kAuto falls
+// back to read/write when the descriptors do not support it. The bar
+// total is the expected size: it is raised to stay above the bytes
+// copied if the stream is longer, and set to them at its end, so that
+// the bar completes once the stream does. Throws std::runtime_error on
+// failure.
+CopyResult copy_stream(int in, int out, ProgressBar *bar = nullptr,
+                       CopyOptions::Method method = CopyOptions::kAuto);
+
+} // namespace progress
+
+#endif // _PROGRESS_COPY_
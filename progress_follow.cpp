@@ -0,0 +1,145 @@
+#include "progress_follow.hpp"
+#include "progress_lines.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace progress {
+
+static std::runtime_error follow_error(const std::string &message) {
+    return std::runtime_error("FileFollower: " + message + ": " + strerror(errno));
+}
+
+FileFollower::FileFollower(const std::string &path, ProgressBar &bar,
+                           const FollowOptions &options)
+      : path_(path), bar_(bar), options_(options) {
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0)
+        throw follow_error("cannot open " + path);
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0 || inotify_add_watch(inotify_fd_, path.c_str(),
+                                             IN_MODIFY | IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+        int error = errno;
+        close(fd_);
+        if (inotify_fd_ >= 0)
+            close(inotify_fd_);
+        errno = error;
+        throw follow_error("cannot watch " + path);
+    }
+    if (pipe2(wake_fds_, O_CLOEXEC)) {
+        int error = errno;
+        close(fd_);
+        close(inotify_fd_);
+        errno = error;
+        throw follow_error("cannot create a pipe");
+    }
+
+    if (!options_.from_start) {
+        off_t end = lseek(fd_, 0, SEEK_END);
+        offset_ = end > 0 ? end : 0;
+    }
+    ProgressBar::Snapshot snapshot = bar_.GetSnapshot();
+    done_ = snapshot.progress;
+    total_ = snapshot.total;
+}
+
+FileFollower::~FileFollower() {
+    close(fd_);
+    close(inotify_fd_);
+    close(wake_fds_[0]);
+    close(wake_fds_[1]);
+}
+
+uint64_t FileFollower::Run() {
+    // what the file holds before the first event
+    ReadAppended();
+
+    alignas(struct inotify_event) char events[4096];
+    while (done_ < total_) {
+        pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {wake_fds_[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            throw follow_error("cannot wait for " + path_);
+        }
+        if (fds[1].revents)
+            break;
+
+        // all pending events are drained, one read covers them
+        bool gone = false;
+        ssize_t length;
+        while ((length = read(inotify_fd_, events, sizeof(events))) > 0) {
+            for (char *p = events; p < events + length;) {
+                const struct inotify_event *event = reinterpret_cast<inotify_event *>(p);
+                if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                    gone = true;
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        // a renamed file may still have been written to before
+        ReadAppended();
+        if (gone)
+            break;
+    }
+    return options_.unit == FollowOptions::kBytes ? bytes_.load() : lines_.load();
+}
+
+void FileFollower::Stop() {
+    char byte = 0;
+    ssize_t ignored = write(wake_fds_[1], &byte, 1);
+    (void)ignored;
+}
+
+uint64_t FileFollower::Bytes() const {
+    return bytes_;
+}
+
+uint64_t FileFollower::Lines() const {
+    return lines_;
+}
+
+// Reads from the offset to the end of the file, or until the bar
+// completes. A file truncated below the offset, e.g. rotated by
+// copytruncate, is read again from its start.
+void FileFollower::ReadAppended() {
+    struct stat st;
+    if (!fstat(fd_, &st) && static_cast<uint64_t>(st.st_size) < offset_)
+        offset_ = 0;
+
+    while (done_ < total_) {
+        ssize_t n = pread(fd_, buffer_, kBufferSize, offset_);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw follow_error("cannot read " + path_);
+        if (n == 0)
+            return;
+
+        uint64_t lines = count_newlines(buffer_, n);
+        offset_ += n;
+        bytes_ += n;
+        lines_ += lines;
+        Count(options_.unit == FollowOptions::kBytes ? n : lines);
+    }
+}
+
+// a file growing past the expected total raises it, so that the bar
+// completes once, with what the file holds
+void FileFollower::Count(uint64_t units) {
+    if (!units)
+        return;
+    if (done_ + units > total_)
+        bar_.SetTotal(total_ = done_ + units);
+    bar_ += units;
+    done_ += units;
+}
+
+} // namespace progress
@@ -0,0 +1,80 @@
+#ifndef _PROGRESS_FOLLOW_
+#define _PROGRESS_FOLLOW_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "progress_bar.hpp"
+
+
+// Progress of a file another process appends to, Linux only.
+//
+// The follower sleeps in poll() on an inotify descriptor and wakes only
+// when the file is modified. It then reads what was appended since its
+// last read, from the offset it keeps, and adds the bytes or complete
+// lines to the bar, whose total is the expected final size or number of
+// lines. The file is never rescanned: only new bytes are read.
+//
+//     ProgressBar bar(expected_lines, "ingest");
+//     progress::FollowOptions options;
+//     options.unit = progress::FollowOptions::kLines;
+//     progress::FileFollower follower("/var/log/ingest.log", bar, options);
+//     follower.Run();
+//
+namespace progress {
+
+struct FollowOptions {
+    enum Unit { kBytes, kLines };
+
+    Unit unit = kBytes;
+    // counts what the file already holds, only what is appended otherwise
+    bool from_start = true;
+};
+
+class FileFollower {
+  public:
+    // throws std::runtime_error if the file cannot be opened or watched
+    FileFollower(const std::string &path, ProgressBar &bar,
+                 const FollowOptions &options = FollowOptions());
+
+    ~FileFollower();
+
+    // follows the file until the bar completes, the file is removed or
+    // renamed, or Stop is called, and returns the units counted; a file
+    // growing past the total raises it
+    uint64_t Run();
+    // makes Run return, from any thread
+    void Stop();
+
+    // can be read from any thread while running
+    uint64_t Bytes() const;
+    uint64_t Lines() const;
+
+  private:
+    FileFollower(const FileFollower &) = delete;
+    FileFollower& operator=(const FileFollower &) = delete;
+
+    static const size_t kBufferSize = 64 * 1024;
+
+    void ReadAppended();
+    void Count(uint64_t units);
+
+    std::string path_;
+    ProgressBar &bar_;
+    FollowOptions options_;
+    int fd_;
+    int inotify_fd_;
+    int wake_fds_[2];
+    uint64_t offset_ = 0;
+    // progress and total of the bar, only moved by the follower
+    uint64_t done_ = 0;
+    uint64_t total_ = 0;
+    std::atomic<uint64_t> bytes_ = {0};
+    std::atomic<uint64_t> lines_ = {0};
+    char buffer_[kBufferSize];
+};
+
+} // namespace progress
+
+#endif // _PROGRESS_FOLLOW_
@@ -0,0 +1,127 @@
+#include "progress_keyspace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace progress {
+
+// the 8 bytes of |key| from |offset| as a big-endian integer, zero padded
+static uint64_t big_endian(const char *key, size_t size, size_t offset) {
+    uint64_t value = 0;
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (size >= offset + 8) {
+        memcpy(&value, key + offset, 8);
+        return __builtin_bswap64(value);
+    }
+#endif
+    for (size_t i = offset; i < offset + 8; ++i)
+        value = value << 8 | (i < size ? static_cast<unsigned char>(key[i]) : 0);
+    return value;
+}
+
+KeySpace::KeySpace(const std::string &start, const std::string &end, size_t max_ranges) {
+    if (start >= end)
+        throw std::runtime_error("KeySpace: start key is not below end key");
+
+    size_t prefix = 0;
+    while (prefix < start.size() && prefix < end.size() && start[prefix] == end[prefix])
+        ++prefix;
+    prefix_ = start.substr(0, prefix);
+
+    uint64_t low = big_endian(start.data(), start.size(), prefix);
+    uint64_t high = big_endian(end.data(), end.size(), prefix);
+    if (low >= high)
+        throw std::runtime_error("KeySpace: keys do not differ within 8 bytes"
+                                 " after their common prefix");
+    Init(low, high, max_ranges);
+}
+
+KeySpace::KeySpace(uint64_t start, uint64_t end, size_t max_ranges) {
+    if (start >= end)
+        throw std::runtime_error("KeySpace: start key is not below end key");
+    Init(start, end, max_ranges);
+}
+
+void KeySpace::Init(uint64_t start, uint64_t end, size_t max_ranges) {
+    start_ = start;
+    end_ = end;
+    max_ranges_ = max_ranges;
+    slots_.reset(new CacheLineArray<Slot>(max_ranges));
+    for (Slot &slot : *slots_)
+        slot.ready.store(false);
+}
+
+KeySpace::Cursor KeySpace::AddRange(const std::string &start, const std::string &end) {
+    return Claim(Position(start.data(), start.size()), Position(end.data(), end.size()));
+}
+
+KeySpace::Cursor KeySpace::AddRange(uint64_t start, uint64_t end) {
+    return Claim(std::max(start, start_), std::min(end, end_));
+}
+
+KeySpace::Cursor KeySpace::AddRange() {
+    return Claim(start_, end_);
+}
+
+KeySpace::Cursor KeySpace::Claim(uint64_t low, uint64_t high) {
+    size_t index = claimed_.fetch_add(1);
+    if (index >= max_ranges_)
+        throw std::runtime_error("KeySpace: more than " + std::to_string(max_ranges_)
+                                 + " ranges");
+
+    Slot &slot = (*slots_)[index];
+    slot.low = low;
+    slot.high = std::max(low, high);
+    slot.position.store(low, std::memory_order_relaxed);
+    slot.ready.store(true, std::memory_order_release);
+    return Cursor(this, &slot);
+}
+
+// Keys outside of the range share less than the common prefix with its
+// bounds; they are clamped to the nearest bound.
+uint64_t KeySpace::Position(const char *key, size_t size) const {
+    int order = memcmp(key, prefix_.data(), std::min(size, prefix_.size()));
+    if (order < 0 || (order == 0 && size < prefix_.size()))
+        return start_;
+    if (order > 0)
+        return end_;
+    return std::min(std::max(big_endian(key, size, prefix_.size()), start_), end_);
+}
+
+// Sums the part of each range already scanned. The ranges being disjoint
+// parts of the key space, the sum does not overflow and reaches the span
+// of the key space exactly when they cover it.
+uint64_t KeySpace::Progress() const {
+    size_t ranges = std::min(claimed_.load(), max_ranges_);
+    uint64_t done = 0;
+    for (size_t i = 0; i < ranges; ++i) {
+        const Slot &slot = (*slots_)[i];
+        if (slot.ready.load(std::memory_order_acquire))
+            done += slot.position.load(std::memory_order_relaxed) - slot.low;
+    }
+
+    uint64_t span = end_ - start_;
+    if (done >= span)
+        return kUnits;
+    return std::min(kUnits - 1, static_cast<uint64_t>(static_cast<double>(done) / span * kUnits));
+}
+
+double KeySpace::Fraction(const std::string &key) const {
+    return static_cast<double>(Position(key.data(), key.size()) - start_) / (end_ - start_);
+}
+
+void KeySpace::Cursor::Set(uint64_t key) {
+    Store(key);
+}
+
+void KeySpace::Cursor::Finish() {
+    slot_->position.store(slot_->high, std::memory_order_relaxed);
+}
+
+void KeySpace::Cursor::Store(uint64_t position) {
+    slot_->position.store(std::min(std::max(position, slot_->low), slot_->high),
+                          std::memory_order_relaxed);
+}
+
+} // namespace progress
@@ -0,0 +1,115 @@
+#ifndef _PROGRESS_KEYSPACE_
+#define _PROGRESS_KEYSPACE_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "cache_line.hpp"
+
+
+// Progress of a scan over a sorted key space, e.g. a key-value store or
+// sorted files, where the number of keys is unknown but the range is.
+//
+// A key is mapped to a position by lexicographic interpolation: the 8
+// bytes following the common prefix of the start and end keys are read
+// as a big-endian integer, so that keys spread evenly in the range give
+// a linear progress. Integer keys are their own position.
+//
+// Workers scanning sub-ranges in parallel each own a cursor, which stores
+// the position of their latest key in its own cache line with a relaxed
+// store. The progress, the sum of the ranges covered, is only computed
+// when the bar samples it in observe mode:
+//
+//     progress::KeySpace space(first_key, last_key);
+//     ProgressBar bar(progress::KeySpace::kUnits,
+//                     [&space] { return space.Progress(); }, "scan");
+//     // for each worker
+//     progress::KeySpace::Cursor cursor = space.AddRange(low, high);
+//     for (...) {
+//         scan(key);
+//         cursor.Set(key);
+//     }
+//     cursor.Finish();
+//
+namespace progress {
+
+class KeySpace {
+    struct Slot;
+
+  public:
+    // units of Progress(), millionths of the key space
+    static const uint64_t kUnits = 1000000;
+
+    class Cursor {
+      public:
+        // the latest key scanned, clamped to the range of the cursor
+        void Set(const char *key, size_t size) {
+            Store(space_->Position(key, size));
+        }
+        void Set(const std::string &key) {
+            Set(key.data(), key.size());
+        }
+        void Set(uint64_t key);
+        // the whole range was scanned, its end key included
+        void Finish();
+
+      private:
+        friend class KeySpace;
+        Cursor(const KeySpace *space, Slot *slot) : space_(space), slot_(slot) {}
+
+        void Store(uint64_t position);
+
+        const KeySpace *space_;
+        Slot *slot_;
+    };
+
+    // the range [start, end), up to |max_ranges| cursors; throws
+    // std::runtime_error if start is not below end, or if the keys do not
+    // differ within 8 bytes after their common prefix
+    KeySpace(const std::string &start, const std::string &end, size_t max_ranges = 64);
+    KeySpace(uint64_t start, uint64_t end, size_t max_ranges = 64);
+
+    // a cursor over [start, end), which should be disjoint from the other
+    // ranges; from any thread, throws std::runtime_error past max_ranges
+    Cursor AddRange(const std::string &start, const std::string &end);
+    Cursor AddRange(uint64_t start, uint64_t end);
+    // a single cursor over the whole key space
+    Cursor AddRange();
+
+    // the part of the key space covered by the cursors, in kUnits; kUnits
+    // only once the cursors cover the whole key space
+    uint64_t Progress() const;
+    // the fraction of the key space below |key|, in [0, 1]
+    double Fraction(const std::string &key) const;
+
+  private:
+    KeySpace(const KeySpace &) = delete;
+    KeySpace& operator=(const KeySpace &) = delete;
+
+    // a cache line per cursor, written by its worker only
+    struct alignas(kCacheLineSize) Slot {
+        std::atomic<uint64_t> position;
+        uint64_t low;
+        uint64_t high;
+        std::atomic<bool> ready;
+    };
+
+    void Init(uint64_t start, uint64_t end, size_t max_ranges);
+    uint64_t Position(const char *key, size_t size) const;
+    Cursor Claim(uint64_t low, uint64_t high);
+
+    // shared by the start and end keys, empty for integer keys
+    std::string prefix_;
+    uint64_t start_;
+    uint64_t end_;
+    size_t max_ranges_;
+    std::unique_ptr<CacheLineArray<Slot>> slots_;
+    std::atomic<size_t> claimed_ = {0};
+};
+
+} // namespace progress
+
+#endif // _PROGRESS_KEYSPACE_
@@ -0,0 +1,237 @@
+#include "progress_lines.hpp"
+#include "progress_algorithms.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HAVE_SSE2_KERNEL 1
+#endif
+
+namespace progress {
+
+// bytes between two bar updates, and per read without a mapping
+const size_t kCountBlock = 1 << 20;
+// ranges smaller than this are not worth a thread
+const size_t kMinRangeSize = 16 << 20;
+
+
+static uint64_t count_newlines_scalar(const char *data, size_t size) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < size; ++i)
+        count += data[i] == '\n';
+    return count;
+}
+
+// Compares 16 bytes at a time. Matches are -1 in bytes, subtracted from
+// byte counters that are summed by _mm_sad_epu8 before they can overflow.
+#ifdef HAVE_SSE2_KERNEL
+static uint64_t count_newlines_sse2(const char *data, size_t size) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t count = 0;
+    size_t i = 0;
+    while (i + 16 <= size) {
+        __m128i counters = zero;
+        for (size_t n = 0; n < 255 && i + 16 <= size; ++n, i += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(bytes, newline));
+        }
+        __m128i sums = _mm_sad_epu8(counters, zero);
+        count += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+    return count + count_newlines_scalar(data + i, size - i);
+}
+#endif
+
+#ifdef HAVE_AVX2_KERNEL
+__attribute__((target("avx2")))
+static uint64_t count_newlines_avx2(const char *data, size_t size) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t count = 0;
+    size_t i = 0;
+    while (i + 32 <= size) {
+        __m256i counters = zero;
+        for (size_t n = 0; n < 255 && i + 32 <= size; ++n, i += 32) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(bytes, newline));
+        }
+        __m256i sums = _mm256_sad_epu8(counters, zero);
+        count += _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+               + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+    }
+    return count + count_newlines_scalar(data + i, size - i);
+}
+#endif
+
+NewlineKernel best_newline_kernel() {
+#ifdef HAVE_AVX2_KERNEL
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2)
+        return kAvx2Kernel;
+#endif
+#ifdef HAVE_SSE2_KERNEL
+    return kSse2Kernel;
+#else
+    return kScalarKernel;
+#endif
+}
+
+const char *newline_kernel_name(NewlineKernel kernel) {
+    switch (kernel) {
+    case kScalarKernel: return "scalar";
+    case kSse2Kernel:   return "sse2";
+    case kAvx2Kernel:   return "avx2";
+    }
+    return "unknown";
+}
+
+uint64_t count_newlines(const char *data, size_t size, NewlineKernel kernel) {
+    if (kernel > best_newline_kernel())
+        kernel = best_newline_kernel();
+
+    switch (kernel) {
+#ifdef HAVE_AVX2_KERNEL
+    case kAvx2Kernel:
+        return count_newlines_avx2(data, size);
+#endif
+#ifdef HAVE_SSE2_KERNEL
+    case kSse2Kernel:
+        return count_newlines_sse2(data, size);
+#endif
+    default:
+        return count_newlines_scalar(data, size);
+    }
+}
+
+static std::runtime_error count_error(const std::string &path) {
+    return std::runtime_error("count_lines: cannot read " + path + ": " + strerror(errno));
+}
+
+// files that cannot be mapped, e.g. pipes or those of /proc
+static uint64_t count_lines_read(int fd, const std::string &path, ProgressBar *bar) {
+    std::vector<char> buffer(kCountBlock);
+    uint64_t newlines = 0;
+    char last = '\n';
+    for (;;) {
+        ssize_t n = read(fd, &buffer[0], buffer.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw count_error(path);
+        if (n == 0)
+            break;
+        newlines += count_newlines(&buffer[0], n);
+        last = buffer[n - 1];
+        if (bar)
+            *bar += n;
+    }
+    return newlines + (last != '\n');
+}
+
+uint64_t count_lines(const std::string &path, ProgressBar *bar, unsigned threads) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        int error = errno;
+        if (fd >= 0)
+            close(fd);
+        errno = error;
+        throw count_error(path);
+    }
+
+    const size_t size = st.st_size;
+    void *mapping = S_ISREG(st.st_mode) && size
+                  ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                  : MAP_FAILED;
+    if (mapping == MAP_FAILED) {
+        try {
+            uint64_t lines = count_lines_read(fd, path, bar);
+            close(fd);
+            return lines;
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+    }
+    close(fd);
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    // one contiguous range per thread, counted block by block
+    const char *data = static_cast<const char *>(mapping);
+    threads = static_cast<unsigned>(std::max<size_t>(1,
+            std::min<size_t>(threads, size / kMinRangeSize)));
+    const size_t range = (size + threads - 1) / threads;
+    std::vector<uint64_t> counts(threads);
+    run_on_threads(threads, [&](unsigned t) {
+        size_t begin = std::min(size, t * range);
+        size_t end = std::min(size, begin + range);
+        uint64_t count = 0;
+        for (size_t block = begin; block < end; block += kCountBlock) {
+            size_t length = std::min(kCountBlock, end - block);
+            count += count_newlines(data + block, length);
+            if (bar)
+                *bar += length;
+        }
+        counts[t] = count;
+    });
+
+    uint64_t lines = data[size - 1] != '\n';
+    for (uint64_t count : counts)
+        lines += count;
+    munmap(mapping, size);
+    return lines;
+}
+
+LineProgress::LineProgress(ProgressBar &bar, const std::string &path, unsigned threads)
+      : bar_(bar) {
+    struct stat st;
+    size_ = stat(path.c_str(), &st) ? 0 : st.st_size;
+    // weighted first, so that a total of 0 lines does not complete the bar
+    bar_.SetTotalCost(size_);
+    bar_.SetTotal(0);
+
+    counter_ = std::thread([this, path, threads] {
+        try {
+            uint64_t lines = count_lines(path, nullptr, threads);
+            lines_ = lines;
+            bar_.SetTotal(lines);
+        } catch (const std::exception &) {
+            // the bar keeps going on bytes only
+        }
+    });
+}
+
+LineProgress::~LineProgress() {
+    Flush();
+    counter_.join();
+}
+
+void LineProgress::Flush() {
+    uint64_t bytes = std::min(pending_bytes_, size_ - consumed_);
+    consumed_ += bytes;
+    if (pending_lines_ || bytes)
+        bar_.Add(pending_lines_, bytes);
+    pending_lines_ = 0;
+    pending_bytes_ = 0;
+}
+
+uint64_t LineProgress::Lines() const {
+    return lines_;
+}
+
+} // namespace progress
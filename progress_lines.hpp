@@ -0,0 +1,90 @@
+#ifndef _PROGRESS_LINES_
+#define _PROGRESS_LINES_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "progress_bar.hpp"
+
+
+// Line counting for "lines processed out of N" bars, POSIX only.
+//
+// Newlines are counted 32 or 16 bytes at a time with AVX2 or SSE2 when
+// the CPU has them, over a memory mapping of the file, optionally split
+// in ranges counted by several threads.
+namespace progress {
+
+enum NewlineKernel { kScalarKernel, kSse2Kernel, kAvx2Kernel };
+
+// the fastest kernel this CPU supports
+NewlineKernel best_newline_kernel();
+const char *newline_kernel_name(NewlineKernel kernel);
+
+// unsupported kernels fall back to the best supported one
+uint64_t count_newlines(const char *data, size_t size,
+                        NewlineKernel kernel = best_newline_kernel());
+
+// Number of lines of |path|, a last line without newline included. The
+// bytes counted are added to |bar| if not null, whose total should be
+// the file size. Throws std::runtime_error if the file cannot be read.
+uint64_t count_lines(const std::string &path, ProgressBar *bar = nullptr,
+                     unsigned threads = 1);
+
+// Progress of a loop over the lines of a file, which starts before the
+// lines are counted. The bar is switched to weighted mode with the file
+// size as total cost: percentage and ETA follow the bytes consumed from
+// the first line, while the lines are displayed. The lines are counted
+// on a background thread, and their number becomes the displayed total
+// once known.
+//
+//     ProgressBar bar(file_size, "parse");
+//     progress::LineProgress progress(bar, path);
+//     while (std::getline(in, line)) {
+//         parse(line);
+//         progress.Line(line.size() + 1);
+//     }
+//
+class LineProgress {
+  public:
+    LineProgress(ProgressBar &bar, const std::string &path, unsigned threads = 1);
+
+    // flushes the pending lines and waits for the count
+    ~LineProgress();
+
+    // one line of |bytes| bytes, its newline included, was processed;
+    // from a single thread
+    void Line(size_t bytes) {
+        ++pending_lines_;
+        pending_bytes_ += bytes;
+        if (pending_bytes_ >= kFlushBytes)
+            Flush();
+    }
+
+    // the number of lines, 0 until counted
+    uint64_t Lines() const;
+
+  private:
+    LineProgress(const LineProgress &) = delete;
+    LineProgress& operator=(const LineProgress &) = delete;
+
+    static const size_t kFlushBytes = 64 * 1024;
+
+    void Flush();
+
+    ProgressBar &bar_;
+    // the file size, bytes past it are not counted so that the bar
+    // completes even if the last line has no newline
+    uint64_t size_;
+    uint64_t consumed_ = 0;
+    uint64_t pending_lines_ = 0;
+    uint64_t pending_bytes_ = 0;
+    std::atomic<uint64_t> lines_ = {0};
+    std::thread counter_;
+};
+
+} // namespace progress
+
+#endif // _PROGRESS_LINES_
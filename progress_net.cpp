@@ -0,0 +1,332 @@
+#include "progress_net.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// frame types, each followed by varint fields
+const uint8_t kFrameHello = 1;    // name length, name bytes
+const uint8_t kFrameUpdate = 2;   // progress, total
+const size_t kMaxNameSize = 255;
+const int kListenBacklog = 64;
+const size_t kReadSize = 4096;
+// weight of the latest update in the smoothed rate of a node
+const double kRateSmoothing = 0.3;
+
+
+static void put_varint(std::string *frame, uint64_t value) {
+    while (value >= 0x80) {
+        frame->push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    frame->push_back(static_cast<char>(value));
+}
+
+// returns the number of bytes consumed, 0 if |size| bytes are not enough
+static size_t get_varint(const char *data, size_t size, uint64_t *value) {
+    *value = 0;
+    for (size_t i = 0; i < size && i < 10; ++i) {
+        *value |= static_cast<uint64_t>(data[i] & 0x7F) << (7 * i);
+        if (!(data[i] & 0x80))
+            return i + 1;
+    }
+    return 0;
+}
+
+static bool send_all(int fd, const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+ProgressPublisher::ProgressPublisher(const ProgressBar &bar,
+                                     const std::string &host,
+                                     uint16_t port,
+                                     const std::string &node_name,
+                                     std::chrono::milliseconds interval)
+      : bar_(bar), interval_(interval), fd_(-1) {
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses))
+        throw std::runtime_error("ProgressPublisher: cannot resolve " + host);
+
+    for (addrinfo *a = addresses; a && fd_ < 0; a = a->ai_next) {
+        fd_ = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd_ >= 0 && connect(fd_, a->ai_addr, a->ai_addrlen)) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (fd_ < 0)
+        throw std::runtime_error("ProgressPublisher: cannot connect to " + host);
+
+    // frames are already coalesced, do not delay them further
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    std::string name = node_name.substr(0, kMaxNameSize);
+    std::string hello(1, static_cast<char>(kFrameHello));
+    put_varint(&hello, name.size());
+    hello += name;
+    send_all(fd_, hello);
+
+    thread_ = std::thread(&ProgressPublisher::Run, this);
+}
+
+ProgressPublisher::~ProgressPublisher() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+    Publish();
+    close(fd_);
+}
+
+void ProgressPublisher::Run() {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (!cv_.wait_for(lock, interval_, [this] { return stop_; })) {
+        if (!Publish())
+            return;
+    }
+}
+
+bool ProgressPublisher::Publish() {
+    ProgressBar::Snapshot snapshot = bar_.GetSnapshot();
+    if (snapshot.cost == sent_progress_ && snapshot.total_cost == sent_total_)
+        return true;
+
+    std::string update(1, static_cast<char>(kFrameUpdate));
+    put_varint(&update, snapshot.cost);
+    put_varint(&update, snapshot.total_cost);
+    if (!send_all(fd_, update))
+        return false;
+
+    sent_progress_ = snapshot.cost;
+    sent_total_ = snapshot.total_cost;
+    return true;
+}
+
+ProgressAggregator::ProgressAggregator(ProgressBar &bar, uint16_t port)
+      : bar_(bar), base_total_(bar.GetSnapshot().total) {
+
+    listen_fd_ = socket(AF_INET6, SOCK_STREAM, 0);
+    if (listen_fd_ < 0)
+        throw std::runtime_error("ProgressAggregator: cannot create socket");
+
+    // accept both IPv4 and IPv6 clients
+    int zero = 0, one = 1;
+    setsockopt(listen_fd_, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in6 address;
+    memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(port);
+    socklen_t size = sizeof(address);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), size)
+            || listen(listen_fd_, kListenBacklog)
+            || getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&address), &size)
+            || pipe(wake_fds_)) {
+        close(listen_fd_);
+        throw std::runtime_error("ProgressAggregator: cannot listen on port "
+                                 + std::to_string(port));
+    }
+    port_ = ntohs(address.sin6_port);
+
+    thread_ = std::thread(&ProgressAggregator::Run, this);
+}
+
+ProgressAggregator::~ProgressAggregator() {
+    char byte = 0;
+    if (write(wake_fds_[1], &byte, 1) != 1)
+        perror("ProgressAggregator");
+    thread_.join();
+
+    for (const Connection &connection : connections_)
+        close(connection.fd);
+    close(listen_fd_);
+    close(wake_fds_[0]);
+    close(wake_fds_[1]);
+}
+
+uint16_t ProgressAggregator::Port() const {
+    return port_;
+}
+
+std::vector<ProgressAggregator::NodeStatus> ProgressAggregator::Nodes() const {
+    std::lock_guard<std::mutex> lock(mu_);
+
+    std::vector<NodeStatus> nodes;
+    for (const auto &node : nodes_)
+        nodes.push_back(node.second.status);
+    return nodes;
+}
+
+void ProgressAggregator::Run() {
+    std::vector<pollfd> fds;
+    while (true) {
+        fds.clear();
+        fds.push_back({wake_fds_[0], POLLIN, 0});
+        fds.push_back({listen_fd_, POLLIN, 0});
+        for (const Connection &connection : connections_)
+            fds.push_back({connection.fd, POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+            continue;
+        if (fds[0].revents)
+            return;
+
+        // connections are polled in order, skip the two leading fds
+        for (size_t i = connections_.size(); i-- > 0;) {
+            if (!fds[i + 2].revents || Consume(&connections_[i]))
+                continue;
+
+            close(connections_[i].fd);
+            std::string name = connections_[i].name;
+            connections_.erase(connections_.begin() + i);
+            // unless the node already reconnected
+            if (std::none_of(connections_.begin(), connections_.end(),
+                             [&name](const Connection &c) { return c.name == name; })) {
+                std::lock_guard<std::mutex> lock(mu_);
+                auto node = nodes_.find(name);
+                if (node != nodes_.end())
+                    node->second.status.connected = false;
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int fd = accept(listen_fd_, nullptr, nullptr);
+            if (fd >= 0)
+                connections_.push_back({fd, "", ""});
+        }
+    }
+}
+
+bool ProgressAggregator::Consume(Connection *connection) {
+    char data[kReadSize];
+    ssize_t n = recv(connection->fd, data, sizeof(data), 0);
+    if (n <= 0)
+        return false;
+    connection->buffer.append(data, n);
+
+    // parse every complete frame, keep the partial tail for the next read
+    const char *p = connection->buffer.data();
+    size_t left = connection->buffer.size();
+    while (left > 0) {
+        uint64_t first, second = 0;
+        size_t used = get_varint(p + 1, left - 1, &first);
+        if (!used)
+            break;
+
+        if (p[0] == kFrameHello) {
+            if (first > kMaxNameSize)
+                return false;
+            if (left < 1 + used + first)
+                break;
+            connection->name.assign(p + 1 + used, first);
+            used += first;
+        } else if (p[0] == kFrameUpdate) {
+            size_t more = get_varint(p + 1 + used, left - 1 - used, &second);
+            if (!more)
+                break;
+            used += more;
+            Apply(connection->name, first, second);
+        } else {
+            return false;
+        }
+
+        p += 1 + used;
+        left -= 1 + used;
+    }
+    connection->buffer.erase(0, connection->buffer.size() - left);
+
+    UpdateStragglers();
+    return true;
+}
+
+// |progress| is the absolute progress of the node, of which only the
+// part not counted yet is added, e.g. after the node reconnected
+void ProgressAggregator::Apply(const std::string &name, uint64_t progress, uint64_t total) {
+    uint64_t delta = 0;
+    uint64_t sum_total = 0;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+
+        auto now = std::chrono::steady_clock::now();
+        auto inserted = nodes_.insert(std::make_pair(name, Node()));
+        Node &node = inserted.first->second;
+        delta = progress > node.status.progress ? progress - node.status.progress : 0;
+        if (inserted.second) {
+            node.status = {name, 0, 0, 0, true};
+        } else {
+            double dt = std::chrono::duration<double>(now - node.last_update).count();
+            if (dt > 0)
+                node.status.rate += kRateSmoothing * (delta / dt - node.status.rate);
+        }
+        node.last_update = now;
+        node.status.progress += delta;
+        node.status.total = total;
+        node.status.connected = true;
+
+        // a node may lower its total below the progress it already made,
+        // which is counted anyway
+        for (const auto &n : nodes_)
+            sum_total += std::max(n.second.status.total, n.second.status.progress);
+    }
+
+    // the total must be raised before the progress it accounts for
+    uint64_t bar_total = std::max(base_total_, sum_total);
+    if (bar_total != bar_.GetSnapshot().total)
+        bar_.SetTotal(bar_total);
+    bar_ += delta;
+}
+
+void ProgressAggregator::UpdateStragglers() {
+    std::string label;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+
+        // the straggler is the node expected to finish last
+        double worst = -1;
+        for (const auto &n : nodes_) {
+            const NodeStatus &status = n.second.status;
+            if (status.progress >= status.total)
+                continue;
+            double remaining = status.rate > 0
+                             ? (status.total - status.progress) / status.rate
+                             : 1e300;
+            if (remaining <= worst)
+                continue;
+            worst = remaining;
+
+            char percent[16];
+            snprintf(percent, sizeof(percent), "%.1f%%",
+                     100.0 * status.progress / status.total);
+            label = "slowest: " + status.name + " " + percent;
+        }
+    }
+    bar_.SetLabel(label);
+}
@@ -0,0 +1,111 @@
+#ifndef _PROGRESS_NET_
+#define _PROGRESS_NET_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "progress_bar.hpp"
+
+
+// Aggregation of progress over TCP, POSIX only.
+//
+// Every node runs a ProgressPublisher that periodically pushes the
+// progress and total of its bar to a ProgressAggregator, which adds the
+// progress made since the previous update of the node to a global bar.
+// Nodes are known by name, so a publisher reconnecting under the same name
+// is not counted twice, and the progress of a node never goes back. An
+// aggregator forwards upward by attaching a publisher to its own global
+// bar, which builds a tree of aggregators.
+//
+// Updates are coalesced: a publisher sends at most one frame per
+// interval whatever the increment rate, and frames are a few bytes of
+// varints, so the bandwidth of a node is bounded by its interval.
+
+class ProgressPublisher {
+  public:
+    ProgressPublisher(const ProgressBar &bar,
+                      const std::string &host,
+                      uint16_t port,
+                      const std::string &node_name,
+                      std::chrono::milliseconds interval = std::chrono::milliseconds(500));
+
+    // flushes the last update and closes the connection
+    ~ProgressPublisher();
+
+  private:
+    ProgressPublisher(const ProgressPublisher &) = delete;
+    ProgressPublisher& operator=(const ProgressPublisher &) = delete;
+
+    void Run();
+    bool Publish();
+
+    const ProgressBar &bar_;
+    std::chrono::milliseconds interval_;
+    int fd_;
+    uint64_t sent_progress_ = 0;
+    uint64_t sent_total_ = 0;
+    bool stop_ = false;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
+class ProgressAggregator {
+  public:
+    struct NodeStatus {
+        std::string name;
+        uint64_t progress;
+        uint64_t total;
+        double rate;        // units per second, smoothed
+        bool connected;
+    };
+
+    // listens on |port| (0 picks a free port) and feeds |bar|, which must
+    // not be weighted, with the sum of the progress and of the totals of
+    // all the nodes
+    ProgressAggregator(ProgressBar &bar, uint16_t port = 0);
+
+    ~ProgressAggregator();
+
+    uint16_t Port() const;
+    std::vector<NodeStatus> Nodes() const;
+
+  private:
+    ProgressAggregator(const ProgressAggregator &) = delete;
+    ProgressAggregator& operator=(const ProgressAggregator &) = delete;
+
+    struct Node {
+        NodeStatus status;
+        std::chrono::steady_clock::time_point last_update;
+    };
+
+    struct Connection {
+        int fd;
+        std::string name;
+        std::string buffer;
+    };
+
+    void Run();
+    bool Consume(Connection *connection);
+    void Apply(const std::string &name, uint64_t progress, uint64_t total);
+    void UpdateStragglers();
+
+    ProgressBar &bar_;
+    uint64_t base_total_;
+    int listen_fd_;
+    int wake_fds_[2];
+    uint16_t port_;
+    std::vector<Connection> connections_;
+    std::map<std::string, Node> nodes_;
+    mutable std::mutex mu_;
+    std::thread thread_;
+};
+
+#endif // _PROGRESS_NET_
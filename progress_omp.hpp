@@ -0,0 +1,147 @@
+#ifndef _PROGRESS_OMP_
+#define _PROGRESS_OMP_
+
+#ifdef _OPENMP
+
+#include <omp.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "cache_line.hpp"
+#include "progress_bar.hpp"
+
+
+// Progress reporting from OpenMP loops.
+//
+// Each thread counts in its own slot, indexed by omp_get_thread_num(),
+// and publishes it to a shared counter once per |chunk| items. Only the
+// master thread moves the bar, so the other threads never draw or wait
+// on the bar lock. Not meant for nested parallel regions.
+//
+// There is a slot per thread of omp_get_max_threads() at construction;
+// threads beyond, from num_threads(n) or a later omp_set_num_threads(),
+// add to the shared counter directly.
+//
+//     OmpProgress progress(bar);
+//     #pragma omp parallel for
+//     for (int i = 0; i < n; ++i) {
+//         work(i);
+//         progress.Tick();
+//     }
+//
+// Tick() looks the thread up on every call. In hot loops, a Counter taken
+// once per thread before the loop counts in a local variable instead:
+//
+//     #pragma omp parallel
+//     {
+//         OmpProgress::Counter counter = progress.ThreadCounter();
+//         #pragma omp for
+//         for (int i = 0; i < n; ++i) {
+//             work(i);
+//             counter.Tick();
+//         }
+//     }
+//
+class OmpProgress {
+  public:
+    // Counts the items of a single thread, publishes them once per chunk
+    // and the rest when destroyed, which must happen before the
+    // OmpProgress is. Moved, not copied.
+    class Counter {
+      public:
+        Counter(Counter &&other)
+              : progress_(other.progress_), chunk_(other.chunk_),
+                master_(other.master_), pending_(other.pending_) {
+            other.pending_ = 0;
+        }
+
+        ~Counter() {
+            progress_.flushed_.fetch_add(pending_, std::memory_order_relaxed);
+        }
+
+        void Tick(uint64_t delta = 1) {
+            pending_ += delta;
+            if (pending_ < chunk_)
+                return;
+
+            progress_.flushed_.fetch_add(pending_, std::memory_order_relaxed);
+            pending_ = 0;
+            if (master_)
+                progress_.Draw();
+        }
+
+      private:
+        friend class OmpProgress;
+        Counter(const Counter &) = delete;
+        Counter& operator=(const Counter &) = delete;
+
+        Counter(OmpProgress &progress, bool master)
+              : progress_(progress), chunk_(progress.chunk_), master_(master) {}
+
+        OmpProgress &progress_;
+        const uint64_t chunk_;
+        const bool master_;
+        uint64_t pending_ = 0;
+    };
+
+    explicit OmpProgress(ProgressBar &bar, uint64_t chunk = 1024)
+          : bar_(bar), chunk_(chunk ? chunk : 1), slots_(omp_get_max_threads()) {}
+
+    // must be destroyed outside of the parallel region
+    ~OmpProgress() {
+        for (Slot &slot : slots_) {
+            flushed_.fetch_add(slot.pending, std::memory_order_relaxed);
+            slot.pending = 0;
+        }
+        Draw();
+    }
+
+    void Tick(uint64_t delta = 1) {
+        size_t thread = omp_get_thread_num();
+        if (thread >= slots_.size()) {
+            flushed_.fetch_add(delta, std::memory_order_relaxed);
+            return;
+        }
+        Slot &slot = slots_[thread];
+        slot.pending += delta;
+        if (slot.pending < chunk_)
+            return;
+
+        flushed_.fetch_add(slot.pending, std::memory_order_relaxed);
+        slot.pending = 0;
+        if (thread == 0)
+            Draw();
+    }
+
+    // the counter of the calling thread, in a parallel region
+    Counter ThreadCounter() {
+        return Counter(*this, omp_get_thread_num() == 0);
+    }
+
+  private:
+    OmpProgress(const OmpProgress &) = delete;
+    OmpProgress& operator=(const OmpProgress &) = delete;
+
+    // one cache line per thread, so that slots are never shared
+    struct alignas(kCacheLineSize) Slot {
+        uint64_t pending = 0;
+    };
+
+    void Draw() {
+        uint64_t flushed = flushed_.load(std::memory_order_relaxed);
+        bar_ += flushed - drawn_;
+        drawn_ = flushed;
+    }
+
+    ProgressBar &bar_;
+    const uint64_t chunk_;
+    CacheLineArray<Slot> slots_;
+    std::atomic<uint64_t> flushed_ = {0};
+    uint64_t drawn_ = 0;   // only touched by the master thread
+};
+
+#endif // _OPENMP
+
+#endif // _PROGRESS_OMP_
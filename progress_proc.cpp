@@ -0,0 +1,279 @@
+#include "progress_proc.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+namespace progress {
+
+// the last frame a bar drew to |sink|, empty if none since the last call;
+// frames end with '\r' and are preceded by blanks clearing the previous one
+static std::string take_frame(std::ostringstream &sink) {
+    std::string text = sink.str();
+    sink.str("");
+    size_t end = text.find_last_not_of("\r\n");
+    if (end == std::string::npos)
+        return "";
+    size_t begin = text.find_last_of("\r\n", end);
+    begin = begin == std::string::npos ? 0 : begin + 1;
+    std::string frame = text.substr(begin, end - begin + 1);
+    return frame.find_first_not_of(' ') == std::string::npos ? "" : frame;
+}
+
+static std::string base_name(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// value of the "<key>:" line of fdinfo, false if there is none
+static bool parse_fdinfo(const char *info, const char *key, uint64_t *value) {
+    size_t length = strlen(key);
+    for (const char *line = info; line; line = strchr(line, '\n')) {
+        if (*line == '\n')
+            ++line;
+        if (!strncmp(line, key, length) && line[length] == ':') {
+            *value = strtoull(line + length + 1, nullptr, 10);
+            return true;
+        }
+    }
+    return false;
+}
+
+ProcessMonitor::File::~File() {
+    // drawn to |sink| on destruction if incomplete
+    bar.reset();
+    close(info_fd);
+    if (file_fd >= 0)
+        close(file_fd);
+}
+
+ProcessMonitor::ProcessMonitor(pid_t pid, std::ostream &out, const MonitorOptions &options)
+      : pid_(pid), out_(out), options_(options) {
+    std::string path = "/proc/" + std::to_string(pid) + "/fd";
+    fd_dir_ = opendir(path.c_str());
+    if (!fd_dir_)
+        throw std::runtime_error("ProcessMonitor: cannot read " + path + ": " + strerror(errno));
+    if (!options_.rescan)
+        options_.rescan = 1;
+
+    // as ProgressBar does, other streams are assumed to end on a terminal
+    terminal_ = !((out_.rdbuf() == std::cout.rdbuf() && !isatty(STDOUT_FILENO))
+               || (out_.rdbuf() == std::cerr.rdbuf() && !isatty(STDERR_FILENO)));
+}
+
+ProcessMonitor::~ProcessMonitor() {
+    files_.clear();
+    closedir(fd_dir_);
+}
+
+bool ProcessMonitor::Poll() {
+    // until a file shows up, the process is likely still opening them
+    bool alive = polls_++ % options_.rescan && !files_.empty() ? true : Rescan();
+    if (alive && kill(pid_, 0) && errno == ESRCH)
+        alive = false;
+
+    for (FileMap::iterator file = files_.begin(); file != files_.end();) {
+        if (alive && Update(file->second.get()))
+            ++file;
+        else
+            file = Close(file);
+    }
+    Render();
+    return alive;
+}
+
+void ProcessMonitor::Run() {
+    while (Poll())
+        std::this_thread::sleep_for(options_.interval);
+}
+
+std::vector<ProcessMonitor::FileStatus> ProcessMonitor::Files() const {
+    std::vector<FileStatus> files;
+    for (const FileMap::value_type &file : files_)
+        files.push_back(file.second->status);
+    return files;
+}
+
+// Lists the descriptors: new regular files are tracked, and those closed
+// or replaced by another file are dropped. Returns false if the process
+// is gone, its descriptor list cannot be read anymore then.
+bool ProcessMonitor::Rescan() {
+    for (FileMap::value_type &file : files_)
+        file.second->seen = false;
+
+    rewinddir(fd_dir_);
+    for (;;) {
+        errno = 0;
+        dirent *entry = readdir(fd_dir_);
+        if (!entry)
+            break;
+        if (entry->d_name[0] == '.')
+            continue;
+
+        struct stat st;
+        if (fstatat(dirfd(fd_dir_), entry->d_name, &st, 0) || !S_ISREG(st.st_mode))
+            continue;
+        int fd = atoi(entry->d_name);
+        FileMap::iterator file = files_.find(fd);
+        if (file != files_.end() && file->second->device == st.st_dev
+                && file->second->inode == st.st_ino) {
+            file->second->seen = true;
+            continue;
+        }
+        if (file != files_.end())
+            Close(file);
+        if (static_cast<uint64_t>(st.st_size) >= options_.min_size)
+            Track(fd, st);
+    }
+    if (errno)
+        return false;
+
+    for (FileMap::iterator file = files_.begin(); file != files_.end();) {
+        if (file->second->seen)
+            ++file;
+        else
+            file = Close(file);
+    }
+    return true;
+}
+
+void ProcessMonitor::Track(int fd, const struct stat &st) {
+    std::string name = std::to_string(fd);
+    std::unique_ptr<File> file(new File);
+    file->status.fd = fd;
+    file->device = st.st_dev;
+    file->inode = st.st_ino;
+    file->seen = true;
+
+    char link[PATH_MAX];
+    ssize_t length = readlinkat(dirfd(fd_dir_), name.c_str(), link, sizeof(link));
+    file->status.path = length > 0 ? std::string(link, length) : name;
+
+    std::string info = "/proc/" + std::to_string(pid_) + "/fdinfo/" + name;
+    file->info_fd = open(info.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file->info_fd < 0)
+        return;
+    // may be refused, e.g. for a file only the process could open
+    file->file_fd = openat(dirfd(fd_dir_), name.c_str(), O_RDONLY | O_CLOEXEC);
+
+    file->status.position = 0;
+    file->status.size = st.st_size;
+    if (!Update(file.get()))
+        return;
+
+    // the bar covers what is left from now, so that the rate and the ETA
+    // are not skewed by the part read before attaching
+    file->base = file->status.position;
+    file->reported = file->base;
+    file->total = std::max(file->status.size, file->base);
+    file->bar.reset(new ProgressBar(file->total - file->base,
+                                    base_name(file->status.path),
+                                    file->sink));
+    if (file->base) {
+        char label[32];
+        snprintf(label, sizeof(label), "attached at %.0f%%",
+                 100.0 * file->base / file->total);
+        file->bar->SetLabel(label);
+    }
+    file->bar->SetByteMode();
+    // bars start their clock at the first increment, one byte starts it
+    // now rather than with a whole poll interval of work at once
+    if (file->total > file->base) {
+        *file->bar += 1;
+        ++file->reported;
+    }
+    file->frame = take_frame(file->sink);
+    file->changed = true;
+    files_[fd] = std::move(file);
+}
+
+// Reads the position and the size, and moves the bar. Returns false if
+// the descriptor was closed, or now refers to another file.
+bool ProcessMonitor::Update(File *file) {
+    ssize_t n = pread(file->info_fd, info_buffer_, sizeof(info_buffer_) - 1, 0);
+    if (n <= 0)
+        return false;
+    info_buffer_[n] = '\0';
+
+    uint64_t position, inode;
+    if (!parse_fdinfo(info_buffer_, "pos", &position))
+        return false;
+    if (parse_fdinfo(info_buffer_, "ino", &inode) && inode != file->inode)
+        return false;
+
+    struct stat st;
+    if (file->file_fd >= 0 ? !fstat(file->file_fd, &st)
+                           : !fstatat(dirfd(fd_dir_), std::to_string(file->status.fd).c_str(),
+                                      &st, 0))
+        file->status.size = st.st_size;
+    file->status.position = position;
+    if (!file->bar)
+        return true;
+
+    // files written grow, and positions may go past the end or backward
+    uint64_t reached = std::min(position, file->status.size);
+    if (file->status.size > file->total) {
+        file->total = file->status.size;
+        file->bar->SetTotal(file->total - file->base);
+    }
+    if (reached > file->reported) {
+        *file->bar += reached - file->reported;
+        file->reported = reached;
+    }
+
+    std::string frame = take_frame(file->sink);
+    if (!frame.empty()) {
+        file->frame = frame;
+        file->changed = true;
+    }
+    return true;
+}
+
+ProcessMonitor::FileMap::iterator ProcessMonitor::Close(FileMap::iterator file) {
+    if (!file->second->frame.empty())
+        finished_.push_back(file->second->frame);
+    return files_.erase(file);
+}
+
+// On a terminal, rewrites the block of lines drawn by the previous call:
+// the files closed since then are written first and scroll up, the open
+// ones after. Otherwise, logs the frames that changed.
+void ProcessMonitor::Render() {
+    bool changed = !finished_.empty() || files_.size() != drawn_lines_;
+    for (const FileMap::value_type &file : files_)
+        changed |= file.second->changed;
+    if (!changed)
+        return;
+
+    std::string text;
+    if (terminal_ && drawn_lines_)
+        text += "\x1b[" + std::to_string(drawn_lines_) + "F";
+    if (terminal_)
+        for (const std::string &frame : finished_)
+            text += frame + "\x1b[K\n";
+    for (const FileMap::value_type &file : files_) {
+        if (terminal_)
+            text += file.second->frame + "\x1b[K\n";
+        else if (file.second->changed)
+            text += file.second->frame + "\n";
+        file.second->changed = false;
+    }
+    if (terminal_)
+        text += "\x1b[J";
+
+    finished_.clear();
+    drawn_lines_ = files_.size();
+    if (!text.empty())
+        out_ << text << std::flush;
+}
+
+} // namespace progress
@@ -0,0 +1,117 @@
+#ifndef _PROGRESS_PROC_
+#define _PROGRESS_PROC_
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "progress_bar.hpp"
+
+
+// Progress of the files another process reads or writes, Linux only.
+//
+// The monitor lists the regular files open in /proc/<pid>/fd and polls
+// their position from /proc/<pid>/fdinfo/<fd> and their size, so that
+// tools without any progress output can be followed, like a decompressor
+// or a database import reading a large dump. Each file gets a byte-mode
+// ProgressBar with rate and ETA, drawn as one line of a block rewritten
+// in place on a terminal, or logged as it changes otherwise.
+//
+// Polling is cheap whatever the number of files: the descriptors of
+// /proc and of the files are opened once, fdinfo is re-read with pread
+// into a fixed buffer and sizes come from fstat, and the descriptor
+// list is only read again every few polls.
+//
+//     progress::ProcessMonitor monitor(pid);
+//     monitor.Run();
+//
+namespace progress {
+
+struct MonitorOptions {
+    std::chrono::milliseconds interval = std::chrono::milliseconds(200);
+    // the descriptors are listed again every |rescan| polls
+    unsigned rescan = 5;
+    // smaller files are not shown
+    uint64_t min_size = 1 << 20;
+};
+
+class ProcessMonitor {
+  public:
+    struct FileStatus {
+        int fd;               // in the monitored process
+        std::string path;
+        uint64_t position;
+        uint64_t size;
+    };
+
+    // throws std::runtime_error if the descriptors of |pid| cannot be
+    // read, e.g. without the permission to trace it
+    ProcessMonitor(pid_t pid, std::ostream &out = std::cerr,
+                   const MonitorOptions &options = MonitorOptions());
+
+    ~ProcessMonitor();
+
+    // reads the positions once and redraws, returns false once the
+    // process has exited
+    bool Poll();
+    // polls every interval until the process exits
+    void Run();
+
+    // the files shown, by descriptor, between two polls
+    std::vector<FileStatus> Files() const;
+
+  private:
+    ProcessMonitor(const ProcessMonitor &) = delete;
+    ProcessMonitor& operator=(const ProcessMonitor &) = delete;
+
+    struct File {
+        FileStatus status;
+        dev_t device;
+        ino_t inode;
+        int info_fd = -1;     // /proc/<pid>/fdinfo/<fd>
+        int file_fd = -1;     // the file itself, if it can be opened
+        uint64_t base;        // position when attached
+        uint64_t reported;    // position added to the bar
+        uint64_t total;
+        bool seen;            // during a rescan
+        std::ostringstream sink;
+        std::unique_ptr<ProgressBar> bar;
+        std::string frame;    // the last one drawn to |sink|
+        bool changed = false; // since the last render
+
+        ~File();
+    };
+
+    typedef std::map<int, std::unique_ptr<File>> FileMap;
+
+    bool Rescan();
+    void Track(int fd, const struct stat &st);
+    bool Update(File *file);
+    FileMap::iterator Close(FileMap::iterator file);
+    void Render();
+
+    pid_t pid_;
+    std::ostream &out_;
+    MonitorOptions options_;
+    bool terminal_;
+    DIR *fd_dir_;             // /proc/<pid>/fd, rewound for every rescan
+    unsigned polls_ = 0;
+    // by descriptor number in the monitored process
+    FileMap files_;
+    // frames of the files closed since the last render
+    std::vector<std::string> finished_;
+    size_t drawn_lines_ = 0;
+    char info_buffer_[512];
+};
+
+} // namespace progress
+
+#endif // _PROGRESS_PROC_
@@ -0,0 +1,148 @@
+#include "progress_slowest.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace progress {
+
+static std::atomic<uint64_t> next_tracker_id(1);
+
+namespace {
+
+// the shard of the tracker this thread recorded to last
+struct ShardCache {
+    uint64_t tracker;
+    void *shard;
+};
+static thread_local ShardCache shard_cache = {0, nullptr};
+
+} // namespace
+
+// heap order putting the fastest item on top
+static bool slower(const SlowestItems::Item &a, const SlowestItems::Item &b) {
+    return a.seconds > b.seconds;
+}
+
+static std::string format_seconds(double seconds) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3fs", seconds);
+    return buffer;
+}
+
+SlowestItems::SlowestItems(ProgressBar &bar, size_t k, std::ostream &report)
+      : bar_(bar), k_(std::max(k, static_cast<size_t>(1))), report_(report),
+        id_(next_tracker_id.fetch_add(1)) {}
+
+SlowestItems::~SlowestItems() {
+    if (Count())
+        Report(report_);
+}
+
+void SlowestItems::Record(double seconds, const char *label, size_t size) {
+    Shard *shard = LocalShard();
+    shard->count.store(shard->count.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+    if (seconds <= shard->threshold || seconds <= threshold_.load(std::memory_order_relaxed))
+        return;
+    Insert(shard, seconds, label, size);
+}
+
+SlowestItems::Shard *SlowestItems::LocalShard() {
+    if (shard_cache.tracker == id_)
+        return static_cast<Shard *>(shard_cache.shard);
+
+    // a thread switching between trackers finds its shard again
+    std::lock_guard<std::mutex> lock(mu_);
+    std::thread::id self = std::this_thread::get_id();
+    Shard *shard = nullptr;
+    for (const std::unique_ptr<Shard> &candidate : shards_)
+        if (candidate->owner == self)
+            shard = candidate.get();
+    if (!shard) {
+        shards_.emplace_back(new Shard);
+        shard = shards_.back().get();
+        shard->owner = self;
+        shard->heap.reserve(k_);
+    }
+    shard_cache.tracker = id_;
+    shard_cache.shard = shard;
+    return shard;
+}
+
+void SlowestItems::Insert(Shard *shard, double seconds, const char *label, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(shard->mu);
+
+        std::vector<Item> &heap = shard->heap;
+        if (heap.size() < k_) {
+            heap.push_back(Item{seconds, std::string(label, size)});
+        } else {
+            // the fastest item is replaced in place, reusing its label
+            std::pop_heap(heap.begin(), heap.end(), slower);
+            heap.back().seconds = seconds;
+            heap.back().label.assign(label, size);
+        }
+        std::push_heap(heap.begin(), heap.end(), slower);
+        if (heap.size() == k_)
+            shard->threshold = heap.front().seconds;
+    }
+    RaiseThreshold(shard->threshold);
+
+    // a new slowest item is rare, it can afford the bar lock
+    if (seconds <= slowest_.load(std::memory_order_relaxed))
+        return;
+    std::lock_guard<std::mutex> lock(label_mu_);
+    if (seconds > slowest_.load()) {
+        slowest_.store(seconds);
+        bar_.SetLabel("slowest " + std::string(label, size) + " " + format_seconds(seconds));
+    }
+}
+
+std::vector<SlowestItems::Item> SlowestItems::Top() const {
+    std::vector<Item> top;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        for (const std::unique_ptr<Shard> &shard : shards_) {
+            std::lock_guard<std::mutex> shard_lock(shard->mu);
+            top.insert(top.end(), shard->heap.begin(), shard->heap.end());
+        }
+    }
+    std::sort(top.begin(), top.end(), slower);
+    if (top.size() > k_)
+        top.resize(k_);
+    if (top.size() == k_)
+        RaiseThreshold(top.back().seconds);
+    return top;
+}
+
+// The k-th slowest item of all threads is at least as slow as that of
+// any thread, so each thread's threshold is also valid for the others.
+void SlowestItems::RaiseThreshold(double seconds) const {
+    double threshold = threshold_.load(std::memory_order_relaxed);
+    while (seconds > threshold && !threshold_.compare_exchange_weak(threshold, seconds))
+        ;
+}
+
+uint64_t SlowestItems::Count() const {
+    std::lock_guard<std::mutex> lock(mu_);
+
+    uint64_t count = 0;
+    for (const std::unique_ptr<Shard> &shard : shards_)
+        count += shard->count.load(std::memory_order_relaxed);
+    return count;
+}
+
+void SlowestItems::Report(std::ostream &out) const {
+    std::vector<Item> top = Top();
+    std::ostringstream os;
+    os << "slowest " << top.size() << " of " << Count() << " items:\n";
+    for (const Item &item : top) {
+        char seconds[32];
+        snprintf(seconds, sizeof(seconds), "%12.3fs  ", item.seconds);
+        os << seconds << item.label << '\n';
+    }
+    out << os.str() << std::flush;
+}
+
+} // namespace progress
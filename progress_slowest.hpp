@@ -0,0 +1,102 @@
+#ifndef _PROGRESS_SLOWEST_
+#define _PROGRESS_SLOWEST_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "progress_bar.hpp"
+
+
+// The K slowest items of a run, to find out which ones make the ETA blow
+// up.
+//
+// Each thread keeps its own bounded heap of the slowest items it saw.
+// An item faster than the K-th slowest of its thread, or of any other
+// thread, is only compared and counted: most items never lock nor copy
+// their label. The heaps are merged when the top items are asked for.
+// The bar is labeled with the slowest item so far, and the top items are
+// written when the tracker is destroyed, so that declared after the bar
+// they follow its final frame.
+//
+//     ProgressBar bar(files.size(), "parse");
+//     progress::SlowestItems slowest(bar, 10);
+//     // from any thread
+//     auto start = std::chrono::steady_clock::now();
+//     parse(file);
+//     slowest.Record(std::chrono::steady_clock::now() - start, file);
+//     ++bar;
+//
+namespace progress {
+
+class SlowestItems {
+  public:
+    struct Item {
+        double seconds;
+        std::string label;
+    };
+
+    // keeps the |k| slowest items, reported to |report| when destroyed
+    SlowestItems(ProgressBar &bar, size_t k = 10, std::ostream &report = std::cerr);
+
+    ~SlowestItems();
+
+    // an item labeled |label| took |seconds|, from any thread
+    void Record(double seconds, const char *label, size_t size);
+    void Record(double seconds, const std::string &label) {
+        Record(seconds, label.data(), label.size());
+    }
+    template <typename Rep, typename Period>
+    void Record(std::chrono::duration<Rep, Period> duration, const std::string &label) {
+        Record(std::chrono::duration<double>(duration).count(), label);
+    }
+
+    // the slowest items of all threads, slowest first
+    std::vector<Item> Top() const;
+    // the number of items recorded
+    uint64_t Count() const;
+    // writes Top() as a table
+    void Report(std::ostream &out) const;
+
+  private:
+    SlowestItems(const SlowestItems &) = delete;
+    SlowestItems& operator=(const SlowestItems &) = delete;
+
+    // written by its thread only, read under |mu| by merges
+    struct Shard {
+        std::thread::id owner;
+        std::mutex mu;
+        // min-heap on the duration, of up to k items
+        std::vector<Item> heap;
+        // the fastest item of a full heap, 0 until full
+        double threshold = 0;
+        std::atomic<uint64_t> count = {0};
+    };
+
+    Shard *LocalShard();
+    void Insert(Shard *shard, double seconds, const char *label, size_t size);
+    void RaiseThreshold(double seconds) const;
+
+    ProgressBar &bar_;
+    size_t k_;
+    std::ostream &report_;
+    // distinguishes trackers in the per-thread cache of shards
+    uint64_t id_;
+    mutable std::mutex mu_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    // under the k-th slowest item of all threads, items below are skipped
+    mutable std::atomic<double> threshold_ = {0};
+    std::atomic<double> slowest_ = {0};
+    std::mutex label_mu_;
+};
+
+} // namespace progress
+
+#endif // _PROGRESS_SLOWEST_
@@ -0,0 +1,35 @@
+#ifndef _PROGRESS_TRACE_
+#define _PROGRESS_TRACE_
+
+// USDT (SystemTap/DTrace) probes of the progress_bar provider, for
+// bpftrace and perf. A probe is a single nop until a tracer attaches.
+// Disabled when <sys/sdt.h> is missing or PROGRESS_BAR_NO_USDT is set.
+//
+//     bpftrace -e 'usdt:./app:progress_bar:render_end { @[arg0] = count(); }'
+//
+// Probes, all with the bar address as first argument:
+//     create(id, total)                 bar constructed
+//     threshold(id, progress, total)    increment crossed an update boundary
+//     render_start(id, progress, total) frame drawing starts, lock held
+//     render_end(id, progress, total)   frame drawing ends
+//     complete(id, total)               progress reached total
+//     destroy(id, progress, total)      bar destroyed
+
+#if !defined(PROGRESS_BAR_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PROGRESS_BAR_USDT 1
+#endif
+#endif
+
+#ifdef PROGRESS_BAR_USDT
+#define PROGRESS_PROBE2(name, a1, a2) \
+    STAP_PROBE2(progress_bar, name, a1, a2)
+#define PROGRESS_PROBE3(name, a1, a2, a3) \
+    STAP_PROBE3(progress_bar, name, a1, a2, a3)
+#else
+#define PROGRESS_PROBE2(name, a1, a2) do {} while (0)
+#define PROGRESS_PROBE3(name, a1, a2, a3) do {} while (0)
+#endif
+
+#endif // _PROGRESS_TRACE_
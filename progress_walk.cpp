@@ -0,0 +1,249 @@
+#include "progress_walk.hpp"
+#include "progress_algorithms.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace progress {
+
+// files queued for visiting beyond which threads stop scanning ahead
+const uint64_t kMaxPendingFiles = 1 << 18;
+
+
+static std::string join_path(const std::string &directory, const char *name) {
+    if (!directory.empty() && directory.back() == '/')
+        return directory + name;
+    return directory + '/' + name;
+}
+
+// Reads the entries of |path| without following symbolic links. The type
+// comes from d_type, and from fstatat only on filesystems not filling it.
+static bool read_directory(const std::string &path,
+                    std::vector<std::string> *directories,
+                    std::vector<std::string> *files) {
+    int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    DIR *dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return false;
+    }
+
+    while (dirent *entry = readdir(dir)) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+            continue;
+
+        bool is_directory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            is_directory = !fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW)
+                        && S_ISDIR(st.st_mode);
+        }
+        if (is_directory)
+            directories->push_back(join_path(path, name));
+        else
+            files->push_back(name);
+    }
+    closedir(dir);
+    return true;
+}
+
+DirectoryWalker::DirectoryWalker(const std::string &root,
+                                 ProgressBar *bar,
+                                 const WalkOptions &options)
+      : root_(root), bar_(bar), options_(options) {
+    if (!options_.threads)
+        options_.threads = default_threads();
+    queues_.reset(new CacheLineArray<WorkQueue>(options_.threads));
+}
+
+uint64_t DirectoryWalker::Run(const Visitor &visit) {
+    struct stat st;
+    if (stat(root_.c_str(), &st) || !S_ISDIR(st.st_mode))
+        throw std::runtime_error("DirectoryWalker: cannot read " + root_);
+
+    pending_directories_ = 1;
+    (*queues_)[0].directories.push_back(root_);
+
+    std::thread prober;
+    if (options_.estimate_probes) {
+        if (bar_)
+            bar_->SetLabel("estimated total");
+        prober = std::thread(&DirectoryWalker::Probe, this);
+    }
+
+    run_on_threads(options_.threads, [&](unsigned worker) {
+        Work(worker, visit);
+    });
+
+    if (prober.joinable())
+        prober.join();
+    return discovered_;
+}
+
+// Scans while the backlog of files is reasonable, visits otherwise, and
+// leaves once nothing is queued nor being processed anywhere.
+void DirectoryWalker::Work(unsigned worker, const Visitor &visit) {
+    std::string directory;
+    for (;;) {
+        if (pending_files_ < kMaxPendingFiles && PopDirectory(worker, &directory)) {
+            Scan(worker, directory);
+            continue;
+        }
+
+        FileBatch batch;
+        {
+            std::lock_guard<std::mutex> lock(files_mu_);
+            if (!file_batches_.empty()) {
+                batch = std::move(file_batches_.front());
+                file_batches_.pop_front();
+            }
+        }
+        if (!batch.names.empty()) {
+            for (const std::string &name : batch.names)
+                visit(join_path(batch.directory, name.c_str()));
+            if (bar_)
+                *bar_ += batch.names.size();
+            pending_files_ -= batch.names.size();
+            continue;
+        }
+
+        if (PopDirectory(worker, &directory)) {
+            Scan(worker, directory);
+            continue;
+        }
+        if (!pending_directories_ && !pending_files_)
+            return;
+        std::this_thread::yield();
+    }
+}
+
+bool DirectoryWalker::PopDirectory(unsigned worker, std::string *directory) {
+    {
+        WorkQueue &own = (*queues_)[worker];
+        std::lock_guard<std::mutex> lock(own.mu);
+        if (!own.directories.empty()) {
+            *directory = std::move(own.directories.back());
+            own.directories.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < queues_->size(); ++i) {
+        WorkQueue &victim = (*queues_)[(worker + i) % queues_->size()];
+        std::lock_guard<std::mutex> lock(victim.mu);
+        if (!victim.directories.empty()) {
+            *directory = std::move(victim.directories.front());
+            victim.directories.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void DirectoryWalker::Scan(unsigned worker, const std::string &directory) {
+    std::vector<std::string> directories;
+    FileBatch batch;
+    batch.directory = directory;
+    if (!read_directory(directory, &directories, &batch.names))
+        ++errors_;
+
+    if (!directories.empty()) {
+        pending_directories_ += directories.size();
+        WorkQueue &own = (*queues_)[worker];
+        std::lock_guard<std::mutex> lock(own.mu);
+        for (std::string &subdirectory : directories)
+            own.directories.push_back(std::move(subdirectory));
+    }
+
+    // the total must cover the files before they can be visited
+    if (!batch.names.empty()) {
+        discovered_ += batch.names.size();
+        pending_files_ += batch.names.size();
+        UpdateTotal();
+    }
+
+    // the last directory completes the scan, whoever reads it
+    if (pending_directories_.fetch_sub(1) == 1) {
+        scan_complete_ = true;
+        UpdateTotal();
+    }
+
+    if (!batch.names.empty()) {
+        std::lock_guard<std::mutex> lock(files_mu_);
+        file_batches_.push_back(std::move(batch));
+    }
+}
+
+void DirectoryWalker::UpdateTotal() {
+    if (!bar_)
+        return;
+
+    std::lock_guard<std::mutex> lock(total_mu_);
+
+    if (scan_complete_) {
+        bar_->SetTotal(discovered_);
+        if (options_.estimate_probes)
+            bar_->SetLabel("");
+        return;
+    }
+    // one more than discovered, the bar must not complete before the scan
+    bar_->SetTotal(std::max(discovered_.load() + 1, estimate_.load()));
+}
+
+// Knuth's estimator: a random walk from the root where every level
+// multiplies the weight by the number of subdirectories to choose from.
+// The weighted file counts along the walk estimate the total number of
+// files, and are averaged over the probes.
+void DirectoryWalker::Probe() {
+    std::mt19937_64 random(std::random_device{}());
+    double sum = 0;
+
+    for (size_t probe = 0; probe < options_.estimate_probes && !scan_complete_; ++probe) {
+        double weight = 1, files = 0;
+        std::string directory = root_;
+        for (;;) {
+            std::vector<std::string> directories, names;
+            if (!read_directory(directory, &directories, &names))
+                break;
+            files += weight * names.size();
+            if (directories.empty())
+                break;
+            weight *= directories.size();
+            directory = directories[random() % directories.size()];
+        }
+
+        sum += files;
+        estimate_ = static_cast<uint64_t>(sum / (probe + 1));
+        if (!scan_complete_)
+            UpdateTotal();
+    }
+}
+
+uint64_t DirectoryWalker::Discovered() const {
+    return discovered_;
+}
+
+uint64_t DirectoryWalker::Estimate() const {
+    return estimate_;
+}
+
+bool DirectoryWalker::ScanComplete() const {
+    return scan_complete_;
+}
+
+uint64_t DirectoryWalker::Errors() const {
+    return errors_;
+}
+
+} // namespace progress
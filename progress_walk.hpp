@@ -0,0 +1,108 @@
+#ifndef _PROGRESS_WALK_
+#define _PROGRESS_WALK_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cache_line.hpp"
+#include "progress_bar.hpp"
+
+
+// Parallel directory traversal feeding a ProgressBar, POSIX only.
+//
+// Files are visited while the tree is still being scanned, so there is
+// no pre-scan: the bar total is raised as directories are read, kept one
+// above the files found so far so that the bar cannot complete early, and
+// is exact once the last directory has been read. Scanning has priority
+// over visiting, so the total is usually known long before the end.
+// Each thread owns a queue of directories and steals from the others
+// when its own is empty.
+//
+// Optionally, the final number of files is estimated early with Knuth's
+// estimator: random walks from the root, each giving the product of the
+// fan-outs met as an unbiased estimate of the tree size. The bar total
+// is the estimate until the scan outgrows it or completes.
+//
+//     ProgressBar bar(0, "indexing");
+//     progress::DirectoryWalker walker("/data", &bar);
+//     walker.Run([](const std::string &path) { index(path); });
+//
+namespace progress {
+
+struct WalkOptions {
+    unsigned threads = 0;       // 0 uses the hardware concurrency
+    // random walks for the estimate, 0 disables it
+    size_t estimate_probes = 0;
+};
+
+class DirectoryWalker {
+  public:
+    // called from the walker threads for every entry that is not a
+    // directory, symbolic links included
+    typedef std::function<void(const std::string &path)> Visitor;
+
+    DirectoryWalker(const std::string &root,
+                    ProgressBar *bar = nullptr,
+                    const WalkOptions &options = WalkOptions());
+
+    // visits every file below the root and returns their number, throws
+    // std::runtime_error if the root cannot be read
+    uint64_t Run(const Visitor &visit);
+
+    // can be read from any thread while running
+    uint64_t Discovered() const;
+    uint64_t Estimate() const;
+    bool ScanComplete() const;
+    // directories that could not be read, they are skipped
+    uint64_t Errors() const;
+
+  private:
+    DirectoryWalker(const DirectoryWalker &) = delete;
+    DirectoryWalker& operator=(const DirectoryWalker &) = delete;
+
+    struct FileBatch {
+        std::string directory;
+        std::vector<std::string> names;
+    };
+
+    // owners push and pop at the back, thieves at the front where the
+    // largest subtrees usually are; one cache line each
+    struct alignas(kCacheLineSize) WorkQueue {
+        std::mutex mu;
+        std::deque<std::string> directories;
+    };
+
+    void Work(unsigned worker, const Visitor &visit);
+    bool PopDirectory(unsigned worker, std::string *directory);
+    void Scan(unsigned worker, const std::string &directory);
+    void Probe();
+    void UpdateTotal();
+
+    std::string root_;
+    ProgressBar *bar_;
+    WalkOptions options_;
+    std::unique_ptr<CacheLineArray<WorkQueue>> queues_;
+
+    std::mutex files_mu_;
+    std::deque<FileBatch> file_batches_;
+    // queued or being scanned, and queued or being visited
+    std::atomic<uint64_t> pending_directories_ = {0};
+    std::atomic<uint64_t> pending_files_ = {0};
+
+    std::atomic<uint64_t> discovered_ = {0};
+    std::atomic<uint64_t> estimate_ = {0};
+    std::atomic<bool> scan_complete_ = {false};
+    std::atomic<uint64_t> errors_ = {0};
+    // serializes the updates of the bar total
+    std::mutex total_mu_;
+};
+
+} // namespace progress
+
+#endif // _PROGRESS_WALK_
@@ -0,0 +1,140 @@
+#include "rate_history.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+const size_t kSecondsPerTenSeconds = 10;
+const size_t kTenSecondsPerMinute = 6;
+
+// U+2581..U+2588, lower one eighth block to full block
+const char *const kSparkGlyphs[] = {
+    "\xe2\x96\x81", "\xe2\x96\x82", "\xe2\x96\x83", "\xe2\x96\x84",
+    "\xe2\x96\x85", "\xe2\x96\x86", "\xe2\x96\x87", "\xe2\x96\x88"
+};
+const int kSparkLevels = 8;
+
+const size_t RateHistory::kSlots;
+
+void RateHistory::Ring::Push(double rate) {
+    slots[head] = rate;
+    head = (head + 1) % kSlots;
+    size = std::min(size + 1, kSlots);
+}
+
+double RateHistory::Ring::Back(size_t i) const {
+    return slots[(head + kSlots - 1 - i) % kSlots];
+}
+
+RateHistory::RateHistory()
+      : started_(false), last_t_(0), last_progress_(0), pending_(0) {
+    for (size_t i = 0; i < kResolutions; ++i) {
+        rings_[i].head = 0;
+        rings_[i].size = 0;
+        rollover_[i] = 0;
+    }
+}
+
+void RateHistory::Record(std::chrono::steady_clock::time_point now,
+                         uint64_t progress) {
+    if (!started_ || progress < last_progress_) {
+        started_ = true;
+        origin_ = now;
+        last_t_ = 0;
+        last_progress_ = progress;
+        return;
+    }
+
+    uint64_t delta = progress - last_progress_;
+    last_progress_ = progress;
+
+    // idle time before the first unit of work is not part of the history
+    if (!delta && !pending_ && !rings_[kSecond].size) {
+        origin_ = now;
+        last_t_ = 0;
+        return;
+    }
+
+    double t = std::chrono::duration<double>(now - origin_).count();
+    double span = t - last_t_;
+    if (span <= 0) {
+        pending_ += delta;
+        return;
+    }
+
+    // spread the progress evenly over all the seconds elapsed since the
+    // previous sample, closing a bucket at every second boundary
+    while (std::floor(last_t_) + 1 <= t) {
+        double boundary = std::floor(last_t_) + 1;
+        pending_ += delta * (boundary - last_t_) / span;
+        PushSecond(pending_);
+        pending_ = 0;
+        last_t_ = boundary;
+    }
+    pending_ += delta * (t - last_t_) / span;
+    last_t_ = t;
+}
+
+void RateHistory::PushSecond(double rate) {
+    rings_[kSecond].Push(rate);
+    if (++rollover_[kSecond] < kSecondsPerTenSeconds)
+        return;
+    rollover_[kSecond] = 0;
+
+    double sum = 0;
+    for (size_t i = 0; i < kSecondsPerTenSeconds; ++i)
+        sum += rings_[kSecond].Back(i);
+    rings_[kTenSeconds].Push(sum / kSecondsPerTenSeconds);
+    if (++rollover_[kTenSeconds] < kTenSecondsPerMinute)
+        return;
+    rollover_[kTenSeconds] = 0;
+
+    sum = 0;
+    for (size_t i = 0; i < kTenSecondsPerMinute; ++i)
+        sum += rings_[kTenSeconds].Back(i);
+    rings_[kMinute].Push(sum / kTenSecondsPerMinute);
+}
+
+std::vector<double> RateHistory::Rates(Resolution resolution) const {
+    const Ring &ring = rings_[resolution];
+    std::vector<double> rates(ring.size);
+    for (size_t i = 0; i < ring.size; ++i)
+        rates[ring.size - 1 - i] = ring.Back(i);
+    return rates;
+}
+
+RateHistory::Stats RateHistory::WindowStats(size_t window) const {
+    const Ring &ring = rings_[kSecond];
+    Stats stats = {0, 0, 0};
+
+    // Welford's online algorithm, numerically stable for long windows
+    double m2 = 0;
+    for (size_t i = 0; i < std::min(window, ring.size); ++i) {
+        double rate = ring.Back(i);
+        ++stats.count;
+        double delta = rate - stats.mean;
+        stats.mean += delta / stats.count;
+        m2 += delta * (rate - stats.mean);
+    }
+    if (stats.count > 1)
+        stats.variance = m2 / (stats.count - 1);
+    return stats;
+}
+
+std::string RateHistory::Sparkline(size_t width) const {
+    const Ring &ring = rings_[kSecond];
+    size_t n = std::min(width, ring.size);
+
+    double max_rate = 0;
+    for (size_t i = 0; i < n; ++i)
+        max_rate = std::max(max_rate, ring.Back(i));
+
+    // left-pad so that the sparkline always takes |width| columns
+    std::string line(width - n, ' ');
+    for (size_t i = n; i-- > 0;) {
+        int level = max_rate > 0
+            ? static_cast<int>(ring.Back(i) / max_rate * (kSparkLevels - 1) + 0.5)
+            : 0;
+        line += kSparkGlyphs[level];
+    }
+    return line;
+}
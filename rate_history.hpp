@@ -0,0 +1,63 @@
+#ifndef _RATE_HISTORY_
+#define _RATE_HISTORY_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Fixed-memory, multi-resolution history of the progress rate.
+// Samples of the cumulative progress are spread over 1 second buckets,
+// every 10 of them are averaged into a 10 second bucket and every 6 of
+// those into a 1 minute bucket. Each resolution keeps the last kSlots
+// buckets, so the memory footprint does not depend on the run length.
+class RateHistory {
+  public:
+    enum Resolution { kSecond = 0, kTenSeconds, kMinute, kResolutions };
+
+    static const size_t kSlots = 60;
+
+    struct Stats {
+        size_t count;
+        double mean;       // units per second
+        double variance;   // of the per-second rate
+    };
+
+    RateHistory();
+
+    // feeds the cumulative progress observed at |now|
+    void Record(std::chrono::steady_clock::time_point now, uint64_t progress);
+
+    // rates in units per second, oldest first
+    std::vector<double> Rates(Resolution resolution) const;
+
+    // mean and variance of the last |window| 1 second buckets
+    Stats WindowStats(size_t window) const;
+
+    // sparkline of the last |width| 1 second buckets
+    std::string Sparkline(size_t width) const;
+
+  private:
+    struct Ring {
+        double slots[kSlots];
+        size_t head;   // index of the next slot to write
+        size_t size;
+
+        void Push(double rate);
+        double Back(size_t i) const;   // i-th most recent rate
+    };
+
+    void PushSecond(double rate);
+
+    Ring rings_[kResolutions];
+    size_t rollover_[kResolutions];   // pushes since the last downsampling
+    bool started_;
+    std::chrono::steady_clock::time_point origin_;
+    double last_t_;                   // seconds since origin_
+    uint64_t last_progress_;
+    double pending_;                  // progress accumulated in the open bucket
+};
+
+#endif // _RATE_HISTORY_
@@ -0,0 +1,159 @@
+#include "run_history.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WINDOWS
+#include <windows.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+// distinguishes the temporary files of the bars of a process
+static std::atomic<unsigned> next_tmp_file(0);
+
+const size_t RunHistory::kCurvePoints;
+
+
+namespace {
+
+// An exclusive lock on a file next to the history, held while alive, on
+// which the writers of every process and thread wait for each other.
+class FileLock {
+  public:
+    explicit FileLock(const std::string &path) {
+#ifdef _WINDOWS
+        handle_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        OVERLAPPED overlapped = {};
+        locked_ = handle_ != INVALID_HANDLE_VALUE
+               && LockFileEx(handle_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+#else
+        // flock locks belong to the open file, so threads exclude each other too
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        int result = -1;
+        while (fd_ >= 0 && (result = flock(fd_, LOCK_EX)) && errno == EINTR) {}
+        locked_ = result == 0;
+#endif
+    }
+
+    // closing the file releases the lock
+    ~FileLock() {
+#ifdef _WINDOWS
+        if (handle_ != INVALID_HANDLE_VALUE)
+            CloseHandle(handle_);
+#else
+        if (fd_ >= 0)
+            close(fd_);
+#endif
+    }
+
+    bool Locked() const { return locked_; }
+
+  private:
+    FileLock(const FileLock &) = delete;
+    FileLock& operator=(const FileLock &) = delete;
+
+#ifdef _WINDOWS
+    HANDLE handle_;
+#else
+    int fd_;
+#endif
+    bool locked_;
+};
+
+} // namespace
+
+
+// keys are written as the last field of a line
+static std::string sanitize_key(const std::string &key) {
+    std::string result = key;
+    std::replace(result.begin(), result.end(), '\t', ' ');
+    std::replace(result.begin(), result.end(), '\n', ' ');
+    return result;
+}
+
+RunHistory::RunHistory(const std::string &path) : path_(path) {}
+
+bool RunHistory::Lookup(const std::string &key, Run *run) const {
+    std::ifstream in(path_);
+    std::string line;
+    std::string wanted = sanitize_key(key);
+
+    while (std::getline(in, line)) {
+        size_t tab = line.rfind('\t');
+        if (tab == std::string::npos || line.substr(tab + 1) != wanted)
+            continue;
+
+        std::istringstream fields(line.substr(0, tab));
+        Run parsed;
+        fields >> parsed.duration >> parsed.total;
+        for (size_t i = 0; i < kCurvePoints; ++i)
+            fields >> parsed.curve[i];
+        if (!fields || parsed.duration <= 0)
+            return false;
+
+        *run = parsed;
+        return true;
+    }
+    return false;
+}
+
+bool RunHistory::Record(const std::string &key, const Run &run) const {
+    // the file is read, rewritten and replaced: without the lock, the runs
+    // recorded by concurrent writers under other keys would be lost
+    FileLock lock(path_ + ".lock");
+    if (!lock.Locked())
+        return false;
+
+    std::string wanted = sanitize_key(key);
+    std::vector<std::string> lines;
+
+    std::ifstream in(path_);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.rfind('\t');
+        if (tab != std::string::npos && line.substr(tab + 1) != wanted)
+            lines.push_back(line);
+    }
+    in.close();
+
+    std::ostringstream entry;
+    entry << run.duration << ' ' << run.total;
+    for (size_t i = 0; i < kCurvePoints; ++i)
+        entry << ' ' << run.curve[i];
+    entry << '\t' << wanted;
+    lines.push_back(entry.str());
+
+    // write aside and rename, so that concurrent readers, which do not
+    // lock, never see a partially written file
+    std::string tmp_path = path_ + ".tmp." + std::to_string(getpid()) + "."
+                         + std::to_string(next_tmp_file.fetch_add(1));
+    std::ofstream out(tmp_path, std::ios::trunc);
+    for (const std::string &l : lines)
+        out << l << '\n';
+    out.close();
+    if (!out || std::rename(tmp_path.c_str(), path_.c_str())) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+double RunHistory::ElapsedFraction(const Run &run, double progress_ratio) {
+    double position = std::min(std::max(progress_ratio, 0.0), 1.0)
+                    * (kCurvePoints - 1);
+    size_t i = std::min(static_cast<size_t>(position), kCurvePoints - 2);
+    double t = position - i;
+    return run.curve[i] + (run.curve[i + 1] - run.curve[i]) * t;
+}
@@ -0,0 +1,40 @@
+#ifndef _RUN_HISTORY_
+#define _RUN_HISTORY_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Small local store of previous runs, keyed by the bar description.
+// Each line of the file holds the duration, the total and the shape of
+// the progress curve of the latest completed run with that key.
+class RunHistory {
+  public:
+    // progress curve sampled at every 5% of progress
+    static const size_t kCurvePoints = 21;
+
+    struct Run {
+        double duration;              // seconds
+        uint64_t total;
+        double curve[kCurvePoints];   // fraction of the duration elapsed
+                                      // when i / 20 of the work was done
+    };
+
+    explicit RunHistory(const std::string &path);
+
+    // loads the latest run recorded under |key|
+    bool Lookup(const std::string &key, Run *run) const;
+
+    // replaces the run recorded under |key|; writers in every process wait
+    // for each other on a lock file, the path followed by ".lock"
+    bool Record(const std::string &key, const Run &run) const;
+
+    // fraction of the duration of |run| elapsed at |progress_ratio|
+    static double ElapsedFraction(const Run &run, double progress_ratio);
+
+  private:
+    std::string path_;
+};
+
+#endif // _RUN_HISTORY_
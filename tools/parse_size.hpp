@@ -0,0 +1,31 @@
+#ifndef _TOOLS_PARSE_SIZE_
+#define _TOOLS_PARSE_SIZE_
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+
+// Parses a size in bytes given on the command line of the tools, with an
+// optional k, M, G or T suffix in powers of 1024, e.g. "1.5G"; returns
+// false if |text| is not one.
+inline bool parse_size(const char *text, uint64_t *size) {
+    char *end;
+    double value = strtod(text, &end);
+    const char *units = "kmgt";
+    double scale = 1;
+    if (*end) {
+        const char *unit = strchr(units, tolower(*end));
+        if (!unit || end[1])
+            return false;
+        for (const char *u = units; u <= unit; ++u)
+            scale *= 1024;
+    }
+    if (end == text || value < 0)
+        return false;
+    *size = static_cast<uint64_t>(value * scale);
+    return true;
+}
+
+#endif // _TOOLS_PARSE_SIZE_
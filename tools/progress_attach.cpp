@@ -0,0 +1,99 @@
+// Shows the progress of another process through the files it has open,
+// one bar per file in bytes and MB/s, until the process exits.
+//
+//     progress_attach [-i interval_ms] [-m min_size] pid
+//     progress_attach [-i interval_ms] [-m min_size] -- command [args...]
+//
+// The second form runs the command and exits with its status. Files
+// smaller than the minimum size, 1M by default, are not shown; sizes take
+// an optional k, M, G or T suffix in powers of 1024.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <thread>
+
+#include <getopt.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "progress_proc.hpp"
+#include "parse_size.hpp"
+
+
+static void usage() {
+    fprintf(stderr, "usage: progress_attach [-i interval_ms] [-m min_size] pid\n"
+                    "       progress_attach [-i interval_ms] [-m min_size] -- command [args...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    progress::MonitorOptions options;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+i:m:")) != -1) {
+        switch (opt) {
+        case 'i':
+            options.interval = std::chrono::milliseconds(std::max(10, atoi(optarg)));
+            break;
+        case 'm':
+            if (!parse_size(optarg, &options.min_size))
+                usage();
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind >= argc)
+        usage();
+
+    // "--" is consumed by getopt, a command is anything but a single pid
+    bool command = strcmp(argv[optind - 1], "--") == 0;
+    pid_t pid;
+    if (command) {
+        pid = fork();
+        if (pid < 0) {
+            perror("progress_attach: fork");
+            return 1;
+        }
+        if (pid == 0) {
+            execvp(argv[optind], argv + optind);
+            fprintf(stderr, "progress_attach: cannot run %s: %s\n", argv[optind], strerror(errno));
+            _exit(127);
+        }
+    } else {
+        char *end;
+        pid = strtol(argv[optind], &end, 10);
+        if (*end || pid <= 0 || optind + 1 != argc)
+            usage();
+    }
+
+    int status = 0;
+    bool reaped = false;
+    try {
+        progress::ProcessMonitor monitor(pid, std::cerr, options);
+        while (monitor.Poll()) {
+            // a child is a zombie until reaped, and would look alive
+            if (command && waitpid(pid, &status, WNOHANG) == pid) {
+                reaped = true;
+                monitor.Poll();
+                break;
+            }
+            std::this_thread::sleep_for(options.interval);
+        }
+    } catch (const std::exception &e) {
+        fprintf(stderr, "progress_attach: %s\n", e.what());
+        if (!command)
+            return 1;
+    }
+
+    if (!command)
+        return 0;
+    if (!reaped)
+        waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
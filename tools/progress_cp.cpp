@@ -0,0 +1,90 @@
+// Copies a file with a progress bar in bytes and MB/s.
+//
+//     progress_cp [-j threads] [-m method] [-v] source destination
+//
+// The destination may be a directory. Methods are copy_file_range,
+// sendfile, splice and read/write, the default picks the first one that
+// works for the two files.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "progress_copy.hpp"
+
+
+static void usage() {
+    fprintf(stderr, "usage: progress_cp [-j threads] [-m method] [-v] source destination\n"
+                    "methods: copy_file_range, sendfile, splice, read/write\n");
+    exit(2);
+}
+
+static bool parse_method(const char *name, progress::CopyOptions::Method *method) {
+    for (int m = progress::CopyOptions::kAuto; m <= progress::CopyOptions::kReadWrite; ++m) {
+        *method = static_cast<progress::CopyOptions::Method>(m);
+        if (!strcmp(name, progress::copy_method_name(*method)))
+            return true;
+    }
+    return false;
+}
+
+static std::string base_name(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+int main(int argc, char **argv) {
+    progress::CopyOptions options;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:m:v")) != -1) {
+        switch (opt) {
+        case 'j':
+            options.threads = std::max(1, atoi(optarg));
+            break;
+        case 'm':
+            if (!parse_method(optarg, &options.method))
+                usage();
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 2)
+        usage();
+
+    std::string source = argv[optind];
+    std::string destination = argv[optind + 1];
+    struct stat st;
+    if (!stat(destination.c_str(), &st) && S_ISDIR(st.st_mode))
+        destination += "/" + base_name(source);
+    if (stat(source.c_str(), &st)) {
+        fprintf(stderr, "progress_cp: cannot stat %s: %s\n", source.c_str(), strerror(errno));
+        return 1;
+    }
+
+    try {
+        ProgressBar bar(st.st_size, base_name(source));
+        bar.SetByteMode();
+        progress::CopyResult result = progress::copy_file(source, destination, &bar, options);
+        if (verbose)
+            fprintf(stderr, "%llu bytes copied with %s\n",
+                    static_cast<unsigned long long>(result.bytes),
+                    progress::copy_method_name(result.method));
+    } catch (const std::exception &e) {
+        fprintf(stderr, "\nprogress_cp: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
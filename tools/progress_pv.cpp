@@ -0,0 +1,101 @@
+// Passes stdin to stdout with a progress bar in bytes and MB/s on stderr,
+// to watch the data flowing through a pipeline.
+//
+//     producer | progress_pv [-s size] [-n name] [-m method] [-v] | consumer
+//
+// The size gives the percentage and the ETA, with an optional k, M, G or
+// T suffix in powers of 1024. Without it, the size of stdin is used if it
+// is a regular file. Methods are splice and read/write, the default
+// splices and falls back to read/write.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include <getopt.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "progress_copy.hpp"
+#include "parse_size.hpp"
+
+
+static void usage() {
+    fprintf(stderr, "usage: progress_pv [-s size] [-n name] [-m method] [-v]\n"
+                    "methods: splice, read/write\n");
+    exit(2);
+}
+
+static bool parse_method(const char *name, progress::CopyOptions::Method *method) {
+    for (progress::CopyOptions::Method m : {progress::CopyOptions::kSplice,
+                                            progress::CopyOptions::kReadWrite}) {
+        if (!strcmp(name, progress::copy_method_name(m))) {
+            *method = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+// what is left of stdin if it is a regular file, 0 otherwise
+static uint64_t input_size() {
+    struct stat st;
+    if (fstat(STDIN_FILENO, &st) || !S_ISREG(st.st_mode))
+        return 0;
+    off_t position = lseek(STDIN_FILENO, 0, SEEK_CUR);
+    return position >= 0 && position < st.st_size ? st.st_size - position : 0;
+}
+
+int main(int argc, char **argv) {
+    progress::CopyOptions::Method method = progress::CopyOptions::kAuto;
+    uint64_t size = 0;
+    std::string name;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:m:v")) != -1) {
+        switch (opt) {
+        case 's':
+            if (!parse_size(optarg, &size))
+                usage();
+            break;
+        case 'n':
+            name = optarg;
+            break;
+        case 'm':
+            if (!parse_method(optarg, &method))
+                usage();
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+    if (!size)
+        size = input_size();
+
+    try {
+        // a total of 0 is unknown, the stream raises it
+        ProgressBar bar(size, name);
+        bar.SetByteMode();
+        if (!size)
+            bar.SetLabel("size unknown");
+        progress::CopyResult result = progress::copy_stream(STDIN_FILENO, STDOUT_FILENO,
+                                                            &bar, method);
+        if (verbose)
+            fprintf(stderr, "%llu bytes copied with %s\n",
+                    static_cast<unsigned long long>(result.bytes),
+                    progress::copy_method_name(result.method));
+    } catch (const std::exception &e) {
+        fprintf(stderr, "\nprogress_pv: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}